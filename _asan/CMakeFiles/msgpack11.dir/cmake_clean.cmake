@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/msgpack11.dir/msgpack11.cpp.o"
+  "CMakeFiles/msgpack11.dir/msgpack11.cpp.o.d"
+  "libmsgpack11.a"
+  "libmsgpack11.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/msgpack11.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/array.dir/array.cpp.o"
+  "CMakeFiles/array.dir/array.cpp.o.d"
+  "array"
+  "array.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/array.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
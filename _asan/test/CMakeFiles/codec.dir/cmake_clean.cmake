@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/codec.dir/codec.cpp.o"
+  "CMakeFiles/codec.dir/codec.cpp.o.d"
+  "codec"
+  "codec.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/codec.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/document.dir/document.cpp.o"
+  "CMakeFiles/document.dir/document.cpp.o.d"
+  "document"
+  "document.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/document.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
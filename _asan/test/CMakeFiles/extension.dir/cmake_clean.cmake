@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/extension.dir/extension.cpp.o"
+  "CMakeFiles/extension.dir/extension.cpp.o.d"
+  "extension"
+  "extension.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/extension.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
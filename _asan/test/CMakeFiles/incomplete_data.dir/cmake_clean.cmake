@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/incomplete_data.dir/incomplete_data.cpp.o"
+  "CMakeFiles/incomplete_data.dir/incomplete_data.cpp.o.d"
+  "incomplete_data"
+  "incomplete_data.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/incomplete_data.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/limits.dir/limits.cpp.o"
+  "CMakeFiles/limits.dir/limits.cpp.o.d"
+  "limits"
+  "limits.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/limits.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
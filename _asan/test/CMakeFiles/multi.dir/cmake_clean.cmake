@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/multi.dir/multi.cpp.o"
+  "CMakeFiles/multi.dir/multi.cpp.o.d"
+  "multi"
+  "multi.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/multi.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/object.dir/object.cpp.o"
+  "CMakeFiles/object.dir/object.cpp.o.d"
+  "object"
+  "object.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/object.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/projection.dir/projection.cpp.o"
+  "CMakeFiles/projection.dir/projection.cpp.o.d"
+  "projection"
+  "projection.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/projection.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/raw.dir/raw.cpp.o"
+  "CMakeFiles/raw.dir/raw.cpp.o.d"
+  "raw"
+  "raw.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/raw.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
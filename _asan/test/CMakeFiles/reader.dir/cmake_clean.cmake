@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/reader.dir/reader.cpp.o"
+  "CMakeFiles/reader.dir/reader.cpp.o.d"
+  "reader"
+  "reader.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/reader.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/timestamp.dir/timestamp.cpp.o"
+  "CMakeFiles/timestamp.dir/timestamp.cpp.o.d"
+  "timestamp"
+  "timestamp.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/timestamp.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/validate.dir/validate.cpp.o"
+  "CMakeFiles/validate.dir/validate.cpp.o.d"
+  "validate"
+  "validate.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/validate.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
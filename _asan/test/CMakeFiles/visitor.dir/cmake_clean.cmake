@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/visitor.dir/visitor.cpp.o"
+  "CMakeFiles/visitor.dir/visitor.cpp.o.d"
+  "visitor"
+  "visitor.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/visitor.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
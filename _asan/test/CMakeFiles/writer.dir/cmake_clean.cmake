@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/writer.dir/writer.cpp.o"
+  "CMakeFiles/writer.dir/writer.cpp.o.d"
+  "writer"
+  "writer.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/writer.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,40 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/test
+# Build directory: /root/repo/_asan/test
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(array "array")
+set_tests_properties(array PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(basic "basic")
+set_tests_properties(basic PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(codec "codec")
+set_tests_properties(codec PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(document "document")
+set_tests_properties(document PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(extension "extension")
+set_tests_properties(extension PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(raw "raw")
+set_tests_properties(raw PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(incomplete_data "incomplete_data")
+set_tests_properties(incomplete_data PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(incremental "incremental")
+set_tests_properties(incremental PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(limits "limits")
+set_tests_properties(limits PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(object "object")
+set_tests_properties(object PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(multi "multi")
+set_tests_properties(multi PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(projection "projection")
+set_tests_properties(projection PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(reader "reader")
+set_tests_properties(reader PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(timestamp "timestamp")
+set_tests_properties(timestamp PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(validate "validate")
+set_tests_properties(validate PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(visitor "visitor")
+set_tests_properties(visitor PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
+add_test(writer "writer")
+set_tests_properties(writer PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;44;ADD_TEST;/root/repo/test/CMakeLists.txt;0;")
@@ -1,11 +1,12 @@
 #include "msgpack11.hpp"
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <limits>
-#include <array>
 #include <tuple>
 #include <algorithm>
 #include <functional>
@@ -13,6 +14,15 @@
 #include <type_traits>
 #include <cstdint>
 #include <utility>
+#include <thread>
+#include <exception>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MSGPACK11_SSE2 1
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 namespace msgpack11 {
 
@@ -21,7 +31,6 @@ static const int max_depth = 200;
 using std::string;
 using std::vector;
 using std::map;
-using std::make_shared;
 using std::initializer_list;
 using std::move;
 
@@ -34,1046 +43,4307 @@ struct NullStruct {
     bool operator<(NullStruct) const { return false; }
 };
 
+/* RawBuffer
+ *
+ * Write position in memory already sized for what is written to it, so that
+ * several threads can encode into disjoint parts of one buffer.
+ */
+struct RawBuffer {
+    uint8_t* pos;
+};
+
+/* RefCount
+ *
+ * Reference count of a value or an arena. In local mode the count is updated
+ * with relaxed loads and stores, which compile to plain memory accesses, so it
+ * must only be touched by one thread at a time.
+ */
+class RefCount {
+public:
+    RefCount() : m_count(1), m_local(false) {}
+
+    void set_local() { m_local = true; }
+    bool local() const { return m_local; }
+
+    void retain() {
+        if (m_local) {
+            m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else {
+            m_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Return true if this dropped the last reference.
+    bool release() {
+        if (m_local) {
+            uint32_t const count = m_count.load(std::memory_order_relaxed) - 1;
+            m_count.store(count, std::memory_order_relaxed);
+            return count == 0;
+        }
+        return m_count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+private:
+    std::atomic<uint32_t> m_count;
+    bool m_local;
+};
+
 /* * * * * * * * * * * * * * * * * * * *
  * MasPackValue
  */
 
 class MsgPackValue {
 public:
+    MsgPackValue() : m_in_arena(false) {}
+    MsgPackValue(const MsgPackValue&) = delete;
+    MsgPackValue& operator=(const MsgPackValue&) = delete;
+
     virtual bool equals(const MsgPackValue * other) const = 0;
     virtual bool less(const MsgPackValue * other) const = 0;
-    virtual void dump(std::ostream& os) const = 0;
+    virtual void dump(std::string& out) const = 0;
+    virtual void dump(MsgPack::binary& out) const = 0;
+    virtual void dump(RawBuffer& out) const = 0;
+    virtual size_t encoded_size() const = 0;
     virtual MsgPack::Type type() const = 0;
-    virtual double number_value() const;
-    virtual float float32_value() const;
-    virtual double float64_value() const;
-    virtual int32_t int_value() const;
-    virtual int8_t int8_value() const;
-    virtual int16_t int16_value() const;
-    virtual int32_t int32_value() const;
-    virtual int64_t int64_value() const;
-    virtual uint8_t uint8_value() const;
-    virtual uint16_t uint16_value() const;
-    virtual uint32_t uint32_value() const;
-    virtual uint64_t uint64_value() const;
-    virtual bool bool_value() const;
     virtual const std::string &string_value() const;
     virtual const MsgPack::array &array_items() const;
     virtual const MsgPack::binary &binary_items() const;
     virtual const MsgPack &operator[](size_t i) const;
     virtual const MsgPack::object &object_items() const;
-    virtual const MsgPack &operator[](const std::string &key) const;
+    virtual const MsgPack &get(const char *key, size_t len) const;
     virtual const MsgPack::extension &extension_items() const;
+    // Bytes of a STRING or BINARY value.
+    virtual const uint8_t *payload_data() const { return nullptr; }
+    virtual size_t payload_size() const { return 0; }
+    // Native value of an EXTENSION decoded by codec.
+    virtual const void *native_value(const MsgPackExtensionCodec &) const { return nullptr; }
+    // Encoded size of an ARRAY or OBJECT once known, else unknown_size.
+    virtual size_t cached_encoded_size() const { return unknown_size; }
+    virtual void set_encoded_size(size_t) const {}
     virtual ~MsgPackValue() {}
+
+    static const size_t unknown_size = static_cast<size_t>(-1);
+
+    // Value held by a MsgPack, or null if the MsgPack holds it inline.
+    static const MsgPackValue *value_of(const MsgPack &handle) {
+        return handle.is_inline() ? nullptr : handle.m_ptr;
+    }
+
+    // Wrap a newly created value in a MsgPack, which takes over its initial
+    // reference.
+    static MsgPack handle(MsgPackValue *value) {
+        return MsgPack(value);
+    }
+
+    void retain() const { m_refs.retain(); }
+    void release() const {
+        if (m_refs.release()) {
+            destroy();
+        }
+    }
+
+    // Count references with plain arithmetic; see RefCount.
+    void set_local() { m_refs.set_local(); }
+    // Mark the value as placed in arena memory right after the arena that
+    // holds it; see ArenaNodes.
+    void set_in_arena() { m_in_arena = true; }
+
+private:
+    void destroy() const;
+
+    mutable RefCount m_refs;
+    bool m_in_arena;
 };
 
+/* * * * * * * * * * * * * * * * * * * *
+ * Threads
+ */
+
+namespace {
+// Below this many bytes per thread, starting threads costs more than it saves.
+static const size_t min_parallel_chunk = 1 << 16;
+// The same for elements of an array or object encoded per thread.
+static const size_t min_parallel_items = 1 << 12;
+
+inline unsigned thread_count(unsigned threads) {
+    return (threads == 0) ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+}
+
+/* run_chunks()
+ *
+ * Call work(i) for each i in [0, chunks), chunk 0 on the calling thread and
+ * every other one on a thread of its own. The first exception thrown by any
+ * chunk is rethrown once all of them have finished.
+ */
+template< typename Work >
+void run_chunks(size_t chunks, const Work& work) {
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(chunks);
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+        workers.emplace_back([&work, &errors, chunk]() {
+            try {
+                work(chunk);
+            } catch (...) {
+                errors[chunk] = std::current_exception();
+            }
+        });
+    }
+    try {
+        work(0);
+    } catch (...) {
+        errors[0] = std::current_exception();
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+}
+
 /* * * * * * * * * * * * * * * * * * * *
  * Serialization
  */
 
 namespace {
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+static const bool is_big_endian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+#else
 static const union {
     uint16_t dummy;
     uint8_t bytes[2];
 } endian_check_data { 0x0001 };
 static const bool is_big_endian = endian_check_data.bytes[0] == 0x00;
+#endif
+
+/* store_be(), load_be()
+ *
+ * Write or read a fixed-width value as big-endian bytes. Compilers turn the
+ * shifts in byte_swap() into a single bswap instruction.
+ */
+inline uint8_t byte_swap(uint8_t value) { return value; }
+
+inline uint16_t byte_swap(uint16_t value) {
+    return static_cast<uint16_t>((value >> 8) | (value << 8));
+}
+
+inline uint32_t byte_swap(uint32_t value) {
+    return ((value >> 24) & 0x000000ffu) | ((value >> 8) & 0x0000ff00u) |
+           ((value << 8) & 0x00ff0000u) | ((value << 24) & 0xff000000u);
+}
+
+inline uint64_t byte_swap(uint64_t value) {
+    return (static_cast<uint64_t>(byte_swap(static_cast<uint32_t>(value))) << 32) |
+           byte_swap(static_cast<uint32_t>(value >> 32));
+}
+
+#ifdef MSGPACK11_SSE2
+/* byte_swap_epi32(), byte_swap_epi64()
+ *
+ * Reverse the bytes of each 32- or 64-bit lane: one pshufb with SSSE3,
+ * otherwise a reversal of the 16-bit words followed by a swap of the bytes
+ * within each word.
+ */
+inline __m128i byte_swap_epi32(__m128i value) {
+#ifdef __SSSE3__
+    return _mm_shuffle_epi8(value, _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+#else
+    value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+#endif
+}
+
+inline __m128i byte_swap_epi64(__m128i value) {
+#ifdef __SSSE3__
+    return _mm_shuffle_epi8(value, _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7));
+#else
+    value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+#endif
+}
+#endif
+
+template< size_t N > struct uint_of_size;
+template<> struct uint_of_size<1> { typedef uint8_t type; };
+template<> struct uint_of_size<2> { typedef uint16_t type; };
+template<> struct uint_of_size<4> { typedef uint32_t type; };
+template<> struct uint_of_size<8> { typedef uint64_t type; };
 
 template< typename T >
-void dump_data(const T value, std::ostream& os)
-{
-    union {
-        T packed;
-        std::array<uint8_t, sizeof(T)> bytes;
-    } converter;
-    converter.packed = value;
-
-    int const n = sizeof(T);
-    int const offsets[] = {(n-1), 0};
-    int const directions[] = {-1, 1};
-    uint8_t const off = offsets[static_cast<int>(is_big_endian)];
-    int const dir = directions[static_cast<int>(is_big_endian)];
-    for(int i = 0; i < n; ++i)
-    {
-        os.put(converter.bytes[off + dir * i]);
+inline void store_be(T value, uint8_t* out) {
+    typename uint_of_size<sizeof(T)>::type bits;
+    std::memcpy(&bits, &value, sizeof(T));
+    if (!is_big_endian) {
+        bits = byte_swap(bits);
+    }
+    std::memcpy(out, &bits, sizeof(T));
+}
+
+template< typename T >
+inline T load_be(const uint8_t* in) {
+    typename uint_of_size<sizeof(T)>::type bits;
+    std::memcpy(&bits, in, sizeof(T));
+    if (!is_big_endian) {
+        bits = byte_swap(bits);
+    }
+    T value;
+    std::memcpy(&value, &bits, sizeof(T));
+    return value;
+}
+
+inline void append(std::string& out, uint8_t byte) {
+    out.push_back(static_cast<char>(byte));
+}
+
+inline void append(MsgPack::binary& out, uint8_t byte) {
+    out.push_back(byte);
+}
+
+inline void append(std::string& out, const uint8_t* data, size_t len) {
+    out.append(reinterpret_cast<const char*>(data), len);
+}
+
+inline void append(MsgPack::binary& out, const uint8_t* data, size_t len) {
+    out.insert(out.end(), data, data + len);
+}
+
+inline void append(RawBuffer& out, uint8_t byte) {
+    *out.pos++ = byte;
+}
+
+inline void append(RawBuffer& out, const uint8_t* data, size_t len) {
+    if (len != 0) {
+        std::memcpy(out.pos, data, len);
+        out.pos += len;
     }
 }
 
-inline void dump(NullStruct, std::ostream& os) {
-    os.put(static_cast<char>(0xc0));
+template< typename T, typename Buffer >
+void dump_data(const T value, Buffer& out)
+{
+    uint8_t bytes[sizeof(T)];
+    store_be(value, bytes);
+    append(out, bytes, sizeof(T));
+}
+
+template< typename Buffer >
+void dump(NullStruct, Buffer& out) {
+    append(out, 0xc0);
 }
 
-inline void dump(float value, std::ostream& os) {
-    os.put(static_cast<char>(0xca));
-    dump_data(value, os);
+template< typename Buffer >
+void dump(float value, Buffer& out) {
+    append(out, 0xca);
+    dump_data(value, out);
 }
 
-inline void dump(double value, std::ostream& os) {
-    os.put(static_cast<char>(0xcb));
-    dump_data(value, os);
+template< typename Buffer >
+void dump(double value, Buffer& out) {
+    append(out, 0xcb);
+    dump_data(value, out);
 }
 
-inline void dump(uint8_t value, std::ostream& os) {
+template< typename Buffer >
+void dump(uint8_t value, Buffer& out) {
     if(128 <= value)
     {
-        os.put(static_cast<char>(0xcc));
+        append(out, 0xcc);
     }
-    os.put(value);
+    append(out, value);
 }
 
-inline void dump(uint16_t value, std::ostream& os) {
+template< typename Buffer >
+void dump(uint16_t value, Buffer& out) {
     if( value < (1 << 8) )
     {
-        dump(static_cast<uint8_t>(value), os );
+        dump(static_cast<uint8_t>(value), out );
     }
     else
     {
-        os.put(static_cast<char>(0xcd));
-        dump_data(value, os);
+        append(out, 0xcd);
+        dump_data(value, out);
     }
 }
 
-inline void dump(uint32_t value, std::ostream& os) {
+template< typename Buffer >
+void dump(uint32_t value, Buffer& out) {
     if( value < (1 << 16) )
     {
-        dump(static_cast<uint16_t>(value), os );
+        dump(static_cast<uint16_t>(value), out );
     }
     else
     {
-        os.put(static_cast<char>(0xce));
-        dump_data(value, os);
+        append(out, 0xce);
+        dump_data(value, out);
     }
 }
 
-inline void dump(uint64_t value, std::ostream& os) {
+template< typename Buffer >
+void dump(uint64_t value, Buffer& out) {
     if( value < (1ULL << 32) )
     {
-        dump(static_cast<uint32_t>(value), os );
+        dump(static_cast<uint32_t>(value), out );
     }
     else
     {
-        os.put(static_cast<char>(0xcf));
-        dump_data(value, os);
+        append(out, 0xcf);
+        dump_data(value, out);
     }
 }
 
-inline void dump(int8_t value, std::ostream& os) {
+template< typename Buffer >
+void dump(int8_t value, Buffer& out) {
     if( value < -32 )
     {
-        os.put(static_cast<char>(0xd0));
+        append(out, 0xd0);
     }
-    os.put(value);
+    append(out, static_cast<uint8_t>(value));
 }
 
-inline void dump(int16_t value, std::ostream& os) {
+template< typename Buffer >
+void dump(int16_t value, Buffer& out) {
     if( value < -(1 << 7) )
     {
-        os.put(static_cast<char>(0xd1));
-        dump_data(value, os);
+        append(out, 0xd1);
+        dump_data(value, out);
     }
     else if( value <= 0 )
     {
-        dump(static_cast<int8_t>(value), os );
+        dump(static_cast<int8_t>(value), out );
     }
     else
     {
-        dump(static_cast<uint16_t>(value), os );
+        dump(static_cast<uint16_t>(value), out );
     }
 }
 
-inline void dump(int32_t value, std::ostream& os) {
+template< typename Buffer >
+void dump(int32_t value, Buffer& out) {
     if( value < -(1 << 15) )
     {
-        os.put(static_cast<char>(0xd2));
-        dump_data(value, os);
+        append(out, 0xd2);
+        dump_data(value, out);
     }
     else if( value <= 0 )
     {
-        dump(static_cast<int16_t>(value), os );
+        dump(static_cast<int16_t>(value), out );
     }
     else
     {
-        dump(static_cast<uint32_t>(value), os );
+        dump(static_cast<uint32_t>(value), out );
     }
 }
 
-inline void dump(int64_t value, std::ostream& os) {
+template< typename Buffer >
+void dump(int64_t value, Buffer& out) {
     if( value < -(1LL << 31) )
     {
-        os.put(static_cast<char>(0xd3));
-        dump_data(value, os);
+        append(out, 0xd3);
+        dump_data(value, out);
     }
     else if( value <= 0 )
     {
-        dump(static_cast<int32_t>(value), os );
+        dump(static_cast<int32_t>(value), out );
     }
     else
     {
-        dump(static_cast<uint64_t>(value), os );
+        dump(static_cast<uint64_t>(value), out );
     }
 }
 
-inline void dump(bool value, std::ostream& os) {
+template< typename Buffer >
+void dump(bool value, Buffer& out) {
     const uint8_t msgpack_value = (value) ? 0xc3 : 0xc2;
-    os.put(msgpack_value);
+    append(out, msgpack_value);
 }
 
-inline void dump(const std::string& value, std::ostream& os) {
-    size_t const len = value.size();
+template< typename Buffer >
+void dump_string(const uint8_t* data, size_t len, Buffer& out) {
     if(len <= 0x1f)
     {
         uint8_t const first_byte = 0xa0 | static_cast<uint8_t>(len);
-        os.put(first_byte);
+        append(out, first_byte);
     }
     else if(len <= 0xff)
     {
-        os.put(static_cast<char>(0xd9));
-        os.put(static_cast<uint8_t>(len));
+        append(out, 0xd9);
+        append(out, static_cast<uint8_t>(len));
     }
     else if(len <= 0xffff)
     {
-        os.put(static_cast<char>(0xda));
-        dump_data(static_cast<uint16_t>(len), os);
+        append(out, 0xda);
+        dump_data(static_cast<uint16_t>(len), out);
     }
     else if(len <= 0xffffffff)
     {
-        os.put(static_cast<char>(0xdb));
-        dump_data(static_cast<uint32_t>(len), os);
+        append(out, 0xdb);
+        dump_data(static_cast<uint32_t>(len), out);
     }
     else
     {
         throw std::runtime_error("exceeded maximum data length");
     }
 
-    std::for_each(std::begin(value), std::end(value), [&os](char v){
-        dump_data(v, os);
-    });
+    append(out, data, len);
+}
+
+template< typename Buffer >
+void dump(const std::string& value, Buffer& out) {
+    dump_string(reinterpret_cast<const uint8_t*>(value.data()), value.size(), out);
 }
 
-inline void dump(const MsgPack::array& value, std::ostream& os) {
-    size_t const len = value.size();
+template< typename Buffer >
+void dump_array_header(size_t len, Buffer& out) {
     if(len <= 15)
     {
         uint8_t const first_byte = 0x90 | static_cast<uint8_t>(len);
-        os.put(first_byte);
+        append(out, first_byte);
     }
     else if(len <= 0xffff)
     {
-        os.put(static_cast<char>(0xdc));
-        dump_data(static_cast<uint16_t>(len), os);
+        append(out, 0xdc);
+        dump_data(static_cast<uint16_t>(len), out);
     }
     else if(len <= 0xffffffff)
     {
-        os.put(static_cast<char>(0xdd));
-        dump_data(static_cast<uint32_t>(len), os);
+        append(out, 0xdd);
+        dump_data(static_cast<uint32_t>(len), out);
     }
     else
     {
         throw std::runtime_error("exceeded maximum data length");
     }
+}
 
-    std::for_each(std::begin(value), std::end(value), [&os](MsgPack::array::value_type const& v){
-        os << v;
-    });
+/* TreeFrame, walk_tree()
+ *
+ * Visit the elements of an array, or the keys and values of an object, in
+ * encoding order. container(type, size) is called for each nested array or
+ * object, before its elements, and leaf(value) for every other value. Nested
+ * containers are entered with an explicit stack rather than recursion, so
+ * any depth is safe, and a flat container is walked without allocating.
+ */
+struct TreeFrame {
+    const MsgPack* items;
+    MsgPack::object::const_iterator pairs;
+    size_t next;
+    size_t count;
+};
+
+inline TreeFrame tree_frame(const MsgPack::array& value) {
+    return TreeFrame{ value.data(), MsgPack::object::const_iterator(), 0, value.size() };
+}
+
+inline TreeFrame tree_frame(const MsgPack::object& value) {
+    return TreeFrame{ nullptr, value.begin(), 0, 2 * value.size() };
+}
+
+// Element i of the frame; the keys and values of an object alternate.
+inline const MsgPack& tree_item(const TreeFrame& frame, size_t i) {
+    return frame.items ? frame.items[i] :
+           ((i % 2 == 0) ? frame.pairs[i / 2].first : frame.pairs[i / 2].second);
+}
+
+template< typename Leaf, typename Container >
+void walk_tree(TreeFrame frame, const Leaf& leaf, const Container& container) {
+    std::vector<TreeFrame> parents;
+    for (;;) {
+        if (frame.next == frame.count) {
+            if (parents.empty()) {
+                return;
+            }
+            frame = parents.back();
+            parents.pop_back();
+            continue;
+        }
+        const MsgPack& value = tree_item(frame, frame.next++);
+        switch (value.type()) {
+            case MsgPack::ARRAY: {
+                const MsgPack::array& items = value.array_items();
+                container(MsgPack::ARRAY, items.size());
+                parents.push_back(frame);
+                frame = tree_frame(items);
+                break;
+            }
+            case MsgPack::OBJECT: {
+                const MsgPack::object& pairs = value.object_items();
+                container(MsgPack::OBJECT, pairs.size());
+                parents.push_back(frame);
+                frame = tree_frame(pairs);
+                break;
+            }
+            default:
+                leaf(value);
+                break;
+        }
+    }
+}
+
+/* compare_trees()
+ *
+ * Compare two arrays, or two objects, element by element in encoding order,
+ * as the operators of their std::vector would. Pairs of nested arrays or
+ * objects are entered with an explicit stack rather than recursion. With
+ * ordered set, return less than, equal to or greater than 0 as a orders
+ * before, with or after b; otherwise return 0 exactly if they are equal.
+ */
+inline int compare_trees(TreeFrame a, TreeFrame b, bool ordered) {
+    if (!ordered && a.count != b.count) {
+        return 1;
+    }
+    std::vector<std::pair<TreeFrame, TreeFrame>> parents;
+    for (;;) {
+        if (a.next == a.count || b.next == b.count) {
+            if (a.count != b.count) {
+                return a.count < b.count ? -1 : 1;
+            }
+            if (parents.empty()) {
+                return 0;
+            }
+            a = parents.back().first;
+            b = parents.back().second;
+            parents.pop_back();
+            continue;
+        }
+        const MsgPack& x = tree_item(a, a.next++);
+        const MsgPack& y = tree_item(b, b.next++);
+        MsgPack::Type const type = x.type();
+        if ((type == MsgPack::ARRAY || type == MsgPack::OBJECT) && type == y.type()) {
+            TreeFrame const x_frame = (type == MsgPack::ARRAY) ? tree_frame(x.array_items()) : tree_frame(x.object_items());
+            TreeFrame const y_frame = (type == MsgPack::ARRAY) ? tree_frame(y.array_items()) : tree_frame(y.object_items());
+            if (!ordered && x_frame.count != y_frame.count) {
+                return 1;
+            }
+            parents.emplace_back(a, b);
+            a = x_frame;
+            b = y_frame;
+        } else if (ordered) {
+            if (x < y) {
+                return -1;
+            } else if (y < x) {
+                return 1;
+            }
+        } else if (!(x == y)) {
+            return 1;
+        }
+    }
+}
+
+template< typename Buffer >
+void dump_header(MsgPack::Type type, size_t len, Buffer& out);
+
+template< typename Buffer >
+void dump_value(const MsgPack& value, Buffer& out);
+
+template< typename Buffer >
+void dump_tree(TreeFrame frame, Buffer& out) {
+    walk_tree(frame,
+        [&out](const MsgPack& value) { dump_value(value, out); },
+        [&out](MsgPack::Type type, size_t len) { dump_header(type, len, out); });
+}
+
+template< typename Buffer >
+void dump(const MsgPack::array& value, Buffer& out) {
+    dump_array_header(value.size(), out);
+    dump_tree(tree_frame(value), out);
 }
 
-inline void dump(const MsgPack::object& value, std::ostream& os) {
-    size_t const len = value.size();
+template< typename Buffer >
+void dump_object_header(size_t len, Buffer& out) {
     if(len <= 15)
     {
         uint8_t const first_byte = 0x80 | static_cast<uint8_t>(len);
-        os.put(first_byte);
+        append(out, first_byte);
     }
     else if(len <= 0xffff)
     {
-        os.put(static_cast<char>(0xde));
-        dump_data(static_cast<uint16_t>(len), os);
+        append(out, 0xde);
+        dump_data(static_cast<uint16_t>(len), out);
     }
     else if(len <= 0xffffffff)
     {
-        os.put(static_cast<char>(0xdf));
-        dump_data(static_cast<uint32_t>(len), os);
+        append(out, 0xdf);
+        dump_data(static_cast<uint32_t>(len), out);
     }
     else
     {
         throw std::runtime_error("too long value.");
     }
+}
 
-    std::for_each(std::begin(value), std::end(value), [&os](MsgPack::object::value_type const& v){
-        os << v.first;
-        os << v.second;
-    });
+template< typename Buffer >
+void dump(const MsgPack::object& value, Buffer& out) {
+    dump_object_header(value.size(), out);
+    dump_tree(tree_frame(value), out);
+}
+
+template< typename Buffer >
+void dump_header(MsgPack::Type type, size_t len, Buffer& out) {
+    if (type == MsgPack::ARRAY) {
+        dump_array_header(len, out);
+    } else {
+        dump_object_header(len, out);
+    }
 }
 
-inline void dump(const MsgPack::binary& value, std::ostream& os) {
-    size_t const len = value.size();
+template< typename Buffer >
+void dump_binary(const uint8_t* data, size_t len, Buffer& out) {
     if(len <= 0xff)
     {
-        os.put(static_cast<char>(0xc4));
-        dump_data(static_cast<uint8_t>(len), os);
+        append(out, 0xc4);
+        dump_data(static_cast<uint8_t>(len), out);
     }
     else if(len <= 0xffff)
     {
-        os.put(static_cast<char>(0xc5));
-        dump_data(static_cast<uint16_t>(len), os);
+        append(out, 0xc5);
+        dump_data(static_cast<uint16_t>(len), out);
     }
     else if(len <= 0xffffffff)
     {
-        os.put(static_cast<char>(0xc6));
-        dump_data(static_cast<uint32_t>(len), os);
+        append(out, 0xc6);
+        dump_data(static_cast<uint32_t>(len), out);
     }
     else
     {
         throw std::runtime_error("exceeded maximum data length");
     }
-    os.write(reinterpret_cast<const char*>(value.data()), value.size());
+    append(out, data, len);
 }
 
-inline void dump(const MsgPack::extension& value, std::ostream& os) {
-    const uint8_t type = std::get<0>( value );
-    const MsgPack::binary& data = std::get<1>( value );
-    const size_t len = data.size();
+template< typename Buffer >
+void dump(const MsgPack::binary& value, Buffer& out) {
+    dump_binary(value.data(), value.size(), out);
+}
+
+template< typename Buffer >
+void dump_extension(int8_t ext_type, const uint8_t* data, size_t len, Buffer& out) {
+    const uint8_t type = static_cast<uint8_t>( ext_type );
 
     if(len == 0x01) {
-        os.put(static_cast<char>(0xd4));
+        append(out, 0xd4);
     }
     else if(len == 0x02) {
-        os.put(static_cast<char>(0xd5));
+        append(out, 0xd5);
     }
     else if(len == 0x04) {
-        os.put(static_cast<char>(0xd6));
+        append(out, 0xd6);
     }
     else if(len == 0x08) {
-        os.put(static_cast<char>(0xd7));
+        append(out, 0xd7);
     }
     else if(len == 0x10) {
-        os.put(static_cast<char>(0xd8));
+        append(out, 0xd8);
     }
     else if(len <= 0xff) {
-        os.put(static_cast<char>(0xc7));
-        os.put(static_cast<uint8_t>(len));
+        append(out, 0xc7);
+        append(out, static_cast<uint8_t>(len));
     }
     else if(len <= 0xffff) {
-        os.put(static_cast<char>(0xc8));
-        dump_data(static_cast<uint16_t>(len), os);
+        append(out, 0xc8);
+        dump_data(static_cast<uint16_t>(len), out);
     }
     else if(len <= 0xffffffff) {
-        os.put(static_cast<char>(0xc9));
-        dump_data(static_cast<uint32_t>(len), os);
+        append(out, 0xc9);
+        dump_data(static_cast<uint32_t>(len), out);
     }
     else {
         throw std::runtime_error("exceeded maximum data length");
     }
 
-    os.put(type);
-    os.write(reinterpret_cast<const char*>(data.data()), data.size());
+    append(out, type);
+    append(out, data, len);
 }
+
+template< typename Buffer >
+void dump(const MsgPack::extension& value, Buffer& out) {
+    const MsgPack::binary& data = std::get<1>( value );
+    dump_extension(std::get<0>( value ), data.data(), data.size(), out);
 }
 
-std::ostream& operator<<(std::ostream& os, const MsgPack& msgpack) {
-    msgpack.m_ptr->dump(os);
-    return os;
+/* normalize_timestamp()
+ *
+ * Carry whole seconds out of nanoseconds of 1000000000 or more, which the
+ * encoded forms cannot hold, so that the value names the same instant.
+ */
+inline MsgPack::timestamp normalize_timestamp(const MsgPack::timestamp& value) {
+    MsgPack::timestamp ret = value;
+    if (1000000000 <= ret.nanoseconds) {
+        // Add in unsigned arithmetic; the carry is at most 4 seconds.
+        ret.seconds = static_cast<int64_t>(static_cast<uint64_t>(ret.seconds) + ret.nanoseconds / 1000000000);
+        ret.nanoseconds %= 1000000000;
+    }
+    return ret;
+}
+template< typename Buffer >
+void dump(const MsgPack::timestamp& value, Buffer& out) {
+    // fixext 4 and fixext 8 need one header byte, ext 8 two; the type
+    // follows either.
+    uint8_t bytes[3 + 12];
+    size_t const len = value.encode(bytes + 3);
+    size_t begin = 0;
+    if (len == 12) {
+        bytes[0] = 0xc7;
+        bytes[1] = 12;
+    } else {
+        begin = 1;
+        bytes[1] = (len == 4) ? 0xd6 : 0xd7;
+    }
+    bytes[2] = 0xff;
+    append(out, bytes + begin, 3 + len - begin);
 }
 
+/* put_number()
+ *
+ * Encode one number at out and return the end of its encoding, choosing the
+ * same width as dump(). Needs at most 1 + sizeof(value) bytes.
+ */
+inline uint8_t* put_uint(uint64_t value, uint8_t* out) {
+    if (value < (1 << 7)) {
+        *out = static_cast<uint8_t>(value);
+        return out + 1;
+    } else if (value < (1 << 8)) {
+        out[0] = 0xcc;
+        out[1] = static_cast<uint8_t>(value);
+        return out + 2;
+    } else if (value < (1 << 16)) {
+        out[0] = 0xcd;
+        store_be(static_cast<uint16_t>(value), out + 1);
+        return out + 3;
+    } else if (value < (1ULL << 32)) {
+        out[0] = 0xce;
+        store_be(static_cast<uint32_t>(value), out + 1);
+        return out + 5;
+    }
+    out[0] = 0xcf;
+    store_be(value, out + 1);
+    return out + 9;
+}
 
+inline uint8_t* put_int(int64_t value, uint8_t* out) {
+    if (0 < value) {
+        return put_uint(static_cast<uint64_t>(value), out);
+    } else if (-32 <= value) {
+        *out = static_cast<uint8_t>(value);
+        return out + 1;
+    } else if (-(1 << 7) <= value) {
+        out[0] = 0xd0;
+        out[1] = static_cast<uint8_t>(value);
+        return out + 2;
+    } else if (-(1 << 15) <= value) {
+        out[0] = 0xd1;
+        store_be(static_cast<int16_t>(value), out + 1);
+        return out + 3;
+    } else if (-(1LL << 31) <= value) {
+        out[0] = 0xd2;
+        store_be(static_cast<int32_t>(value), out + 1);
+        return out + 5;
+    }
+    out[0] = 0xd3;
+    store_be(value, out + 1);
+    return out + 9;
+}
 
-/* * * * * * * * * * * * * * * * * * * *
- * Value wrappers
- */
+inline uint8_t* put_number(float value, uint8_t* out) {
+    out[0] = 0xca;
+    store_be(value, out + 1);
+    return out + 5;
+}
 
-template <MsgPack::Type tag, typename T>
-class Value : public MsgPackValue {
-protected:
+inline uint8_t* put_number(double value, uint8_t* out) {
+    out[0] = 0xcb;
+    store_be(value, out + 1);
+    return out + 9;
+}
 
-    // Constructors
-    explicit Value(const T &value) : m_value(value) {}
-    explicit Value(T &&value)      : m_value(std::move(value)) {}
+template< typename T >
+inline typename std::enable_if<std::is_signed<T>::value, uint8_t*>::type put_number(T value, uint8_t* out) {
+    return put_int(value, out);
+}
 
-    // Get type tag
-    MsgPack::Type type() const override {
-        return tag;
+template< typename T >
+inline typename std::enable_if<std::is_unsigned<T>::value, uint8_t*>::type put_number(T value, uint8_t* out) {
+    return put_uint(value, out);
+}
+
+/* put_fixints()
+ *
+ * Encode the longest prefix of data made of whole blocks of fixints (values
+ * in [-32, 127], one byte each) and return how many values it encoded. Only
+ * done with SSE2, for 32- and 16-bit values, where a block is checked and
+ * narrowed to bytes in a few instructions.
+ */
+template< typename T >
+inline size_t put_fixints(const T*, size_t, uint8_t*) {
+    return 0;
+}
+
+#ifdef MSGPACK11_SSE2
+inline bool all_fixints_epi32(__m128i values) {
+    __m128i const out_of_range = _mm_or_si128(_mm_cmpgt_epi32(values, _mm_set1_epi32(127)),
+                                              _mm_cmplt_epi32(values, _mm_set1_epi32(-32)));
+    return _mm_movemask_epi8(out_of_range) == 0;
+}
+
+inline size_t put_fixints(const int32_t* data, size_t n, uint8_t* out) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i* const block = reinterpret_cast<const __m128i*>(data + i);
+        __m128i const a = _mm_loadu_si128(block);
+        __m128i const b = _mm_loadu_si128(block + 1);
+        __m128i const c = _mm_loadu_si128(block + 2);
+        __m128i const d = _mm_loadu_si128(block + 3);
+        if (!(all_fixints_epi32(a) && all_fixints_epi32(b) && all_fixints_epi32(c) && all_fixints_epi32(d))) {
+            break;
+        }
+        // Every value is in range, so the saturating packs are exact.
+        __m128i const bytes = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
     }
+    return i;
+}
 
-    // Comparisons
-    bool equals(const MsgPackValue * other) const override {
-        bool const is_same_type = tag == other->type();
-        return is_same_type && (m_value == static_cast<const Value<tag, T> *>(other)->m_value);
+inline size_t put_fixints(const int16_t* data, size_t n, uint8_t* out) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i* const block = reinterpret_cast<const __m128i*>(data + i);
+        __m128i const a = _mm_loadu_si128(block);
+        __m128i const b = _mm_loadu_si128(block + 1);
+        __m128i const out_of_range = _mm_or_si128(
+            _mm_or_si128(_mm_cmpgt_epi16(a, _mm_set1_epi16(127)), _mm_cmplt_epi16(a, _mm_set1_epi16(-32))),
+            _mm_or_si128(_mm_cmpgt_epi16(b, _mm_set1_epi16(127)), _mm_cmplt_epi16(b, _mm_set1_epi16(-32))));
+        if (_mm_movemask_epi8(out_of_range) != 0) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi16(a, b));
     }
-    bool less(const MsgPackValue * other) const override {
-        bool const is_same_type = tag == other->type();
-        bool const is_less_type = tag < other->type();
-        return is_less_type || (is_same_type && (m_value < static_cast<const Value<tag, T> *>(other)->m_value));
+    return i;
+}
+#endif
+
+/* put_blocks()
+ *
+ * Encode the longest prefix of data that can be done a block at a time,
+ * advance pos past it and return how many values it encoded: whole blocks
+ * of fixints for integers, and for floats every whole 16 bytes of values,
+ * byte-swapped in one step and then spread out behind their tags.
+ */
+template< typename T >
+inline size_t put_blocks(const T* data, size_t n, uint8_t*& pos) {
+    size_t const packed = put_fixints(data, n, pos);
+    pos += packed;
+    return packed;
+}
+
+#ifdef MSGPACK11_SSE2
+template< typename T >
+inline size_t put_float_blocks(const T* data, size_t n, uint8_t*& pos) {
+    size_t const per_block = 16 / sizeof(T);
+    uint8_t const tag = (sizeof(T) == sizeof(float)) ? 0xca : 0xcb;
+    size_t i = 0;
+    for (; i + per_block <= n; i += per_block) {
+        __m128i const block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        uint8_t bytes[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes),
+                         (sizeof(T) == sizeof(float)) ? byte_swap_epi32(block) : byte_swap_epi64(block));
+        for (size_t k = 0; k < per_block; ++k) {
+            pos[0] = tag;
+            std::memcpy(pos + 1, bytes + k * sizeof(T), sizeof(T));
+            pos += 1 + sizeof(T);
+        }
     }
+    return i;
+}
 
-    const T m_value;
-    void dump(std::ostream& os) const override { msgpack11::dump(m_value, os); }
-};
+inline size_t put_blocks(const float* data, size_t n, uint8_t*& pos) {
+    return put_float_blocks(data, n, pos);
+}
 
-bool equal_uint64_int64( uint64_t uint64_value, int64_t int64_value )
-{
-    bool const is_positive = 0 <= int64_value;
-    bool const is_leq_int64_max = uint64_value <= static_cast<std::uint64_t>(std::numeric_limits<int64_t>::max());
-    return is_positive && is_leq_int64_max && ( uint64_value == static_cast<uint64_t>(int64_value));
+inline size_t put_blocks(const double* data, size_t n, uint8_t*& pos) {
+    return put_float_blocks(data, n, pos);
 }
+#endif
 
-bool less_uint64_int64( uint64_t uint64_value, int64_t int64_value )
-{
-    bool const is_positive = 0 <= int64_value;
-    bool const is_leq_int64_max = uint64_value <= static_cast<std::uint64_t>(std::numeric_limits<int64_t>::max());
-    return is_positive && is_leq_int64_max && ( uint64_value < static_cast<uint64_t>(int64_value));
+/* dump_number_array()
+ *
+ * Append an ARRAY of n numbers, encoded as dump() encodes each of them but
+ * written through a pointer into space reserved for the worst case.
+ */
+template< typename T, typename Buffer >
+void dump_number_array(const T* data, size_t n, Buffer& out) {
+    dump_array_header(n, out);
+    size_t const start = out.size();
+    out.resize(start + n * (1 + sizeof(T)));
+    uint8_t* const begin = reinterpret_cast<uint8_t*>(&out[0]) + start;
+    uint8_t* pos = begin;
+    size_t i = 0;
+    while (i < n) {
+        i += put_blocks(data + i, n - i, pos);
+        // Encode at least a block one by one before trying the fast path again.
+        for (size_t const end = std::min<size_t>(n, i + 16); i < end; ++i) {
+            pos = put_number(data[i], pos);
+        }
+    }
+    out.resize(start + static_cast<size_t>(pos - begin));
 }
 
-bool less_int64_uint64( int64_t int64_value, uint64_t uint64_value )
-{
-    bool const is_negative = int64_value < 0;
-    bool const is_gt_int64_max = static_cast<std::uint64_t>(std::numeric_limits<int64_t>::max()) < uint64_value;
-    return is_negative || is_gt_int64_max || ( static_cast<uint64_t>(int64_value) < uint64_value );
+/* encoded_size()
+ *
+ * Number of bytes the matching dump() writes. Each overload follows the width
+ * selection of its dump() counterpart.
+ */
+inline size_t encoded_size(NullStruct) { return 1; }
+inline size_t encoded_size(float) { return 1 + sizeof(float); }
+inline size_t encoded_size(double) { return 1 + sizeof(double); }
+inline size_t encoded_size(bool) { return 1; }
+
+inline size_t encoded_size(uint8_t value) {
+    return (128 <= value) ? 2 : 1;
 }
 
-template <MsgPack::Type tag, typename T>
-class NumberValue : public Value<tag, T>  {
-protected:
+inline size_t encoded_size(uint16_t value) {
+    return ( value < (1 << 8) ) ? encoded_size(static_cast<uint8_t>(value)) : 3;
+}
 
-    // Constructors
-    explicit NumberValue(const T &value) : Value<tag, T>(value) {}
-    explicit NumberValue(T &&value)      : Value<tag, T>(move(value)) {}
+inline size_t encoded_size(uint32_t value) {
+    return ( value < (1 << 16) ) ? encoded_size(static_cast<uint16_t>(value)) : 5;
+}
 
-    bool equals(const MsgPackValue * other) const override {
-        switch( other->type() )
-        {
-            case MsgPack::FLOAT32 : // fall through
-            case MsgPack::FLOAT64 : // fall through
-            case MsgPack::UINT8   : // fall through
-            case MsgPack::UINT16  : // fall through
-            case MsgPack::UINT32  : // fall through
-            case MsgPack::UINT64  : // fall through
-            case MsgPack::INT8    : // fall through
-            case MsgPack::INT16   : // fall through
-            case MsgPack::INT32   : // fall through
-            case MsgPack::INT64   : // fall through
-            {
-                return float64_value() == other->float64_value();
-            } break;
-            default               :
-            {
-                return Value<tag,T>::equals( other );
-            } break;
-        }
-    }
+inline size_t encoded_size(uint64_t value) {
+    return ( value < (1ULL << 32) ) ? encoded_size(static_cast<uint32_t>(value)) : 9;
+}
 
-    bool less(const MsgPackValue * other) const override {
-        switch( other->type() )
-        {
-            case MsgPack::FLOAT32 : // fall through
-            case MsgPack::FLOAT64 : // fall through
-            case MsgPack::UINT8   : // fall through
-            case MsgPack::UINT16  : // fall through
-            case MsgPack::UINT32  : // fall through
-            case MsgPack::UINT64  : // fall through
-            case MsgPack::INT8    : // fall through
-            case MsgPack::INT16   : // fall through
-            case MsgPack::INT32   : // fall through
-            case MsgPack::INT64   : // fall through
-            {
-                return float64_value() < other->float64_value();
-            } break;
-            default               :
-            {
-                return Value<tag,T>::less( other );
-            } break;
-        }
-    }
-
-    double  number_value()  const override { return static_cast<double>( Value<tag,T>::m_value ); }
-    float float32_value()   const override { return static_cast<float>( Value<tag,T>::m_value ); }
-    double float64_value()  const override { return static_cast<double>( Value<tag,T>::m_value ); }
-    int32_t int_value()     const override { return static_cast<int32_t>( Value<tag,T>::m_value ); }
-    int8_t int8_value()     const override { return static_cast<int8_t>( Value<tag,T>::m_value ); }
-    int16_t int16_value()   const override { return static_cast<int16_t>( Value<tag,T>::m_value ); }
-    int32_t int32_value()   const override { return static_cast<int32_t>( Value<tag,T>::m_value ); }
-    int64_t int64_value()   const override { return static_cast<int64_t>( Value<tag,T>::m_value ); }
-    uint8_t uint8_value()   const override { return static_cast<uint8_t>( Value<tag,T>::m_value ); }
-    uint16_t uint16_value() const override { return static_cast<uint16_t>( Value<tag,T>::m_value ); }
-    uint32_t uint32_value() const override { return static_cast<uint32_t>( Value<tag,T>::m_value ); }
-    uint64_t uint64_value() const override { return static_cast<uint64_t>( Value<tag,T>::m_value ); }
-};
+inline size_t encoded_size(int8_t value) {
+    return ( value < -32 ) ? 2 : 1;
+}
 
-class MsgPackFloat final : public NumberValue<MsgPack::FLOAT32, float> {
-public:
-    explicit MsgPackFloat(float value) : NumberValue(value) {}
-};
+inline size_t encoded_size(int16_t value) {
+    if( value < -(1 << 7) ) return 3;
+    else if( value <= 0 ) return encoded_size(static_cast<int8_t>(value));
+    else return encoded_size(static_cast<uint16_t>(value));
+}
 
-class MsgPackDouble final : public NumberValue<MsgPack::FLOAT64, double> {
-public:
-    explicit MsgPackDouble(double value) : NumberValue(value) {}
-};
+inline size_t encoded_size(int32_t value) {
+    if( value < -(1 << 15) ) return 5;
+    else if( value <= 0 ) return encoded_size(static_cast<int16_t>(value));
+    else return encoded_size(static_cast<uint32_t>(value));
+}
 
-class MsgPackInt8 final : public NumberValue<MsgPack::INT8, int8_t> {
-public:
-    explicit MsgPackInt8(int8_t value) : NumberValue(value) {}
-};
+inline size_t encoded_size(int64_t value) {
+    if( value < -(1LL << 31) ) return 9;
+    else if( value <= 0 ) return encoded_size(static_cast<int32_t>(value));
+    else return encoded_size(static_cast<uint64_t>(value));
+}
 
-class MsgPackInt16 final : public NumberValue<MsgPack::INT16, int16_t> {
-public:
-    explicit MsgPackInt16(int16_t value) : NumberValue(value) {}
-};
+inline size_t string_encoded_size(size_t len) {
+    if(len <= 0x1f) return 1 + len;
+    else if(len <= 0xff) return 2 + len;
+    else if(len <= 0xffff) return 3 + len;
+    else if(len <= 0xffffffff) return 5 + len;
+    throw std::runtime_error("exceeded maximum data length");
+}
 
-class MsgPackInt32 final : public NumberValue<MsgPack::INT32, int32_t> {
-public:
-    explicit MsgPackInt32(int32_t value) : NumberValue(value) {}
-};
+inline size_t encoded_size(const std::string& value) {
+    return string_encoded_size(value.size());
+}
 
-class MsgPackInt64 final : public NumberValue<MsgPack::INT64, int64_t> {
-    bool equals(const MsgPackValue * other) const override
-    {
-        switch( other->type() )
-        {
-            case MsgPack::INT64 :
-            {
-                return int64_value() == other->int64_value();
-            } break;
-            case MsgPack::UINT64 :
-            {
-                return equal_uint64_int64( other->uint64_value(), int64_value() );
-            } break;
-            default :
-            {
-                return NumberValue<MsgPack::INT64, int64_t>::equals( other );
+inline size_t container_header_size(size_t len) {
+    if(len <= 15) return 1;
+    else if(len <= 0xffff) return 3;
+    else if(len <= 0xffffffff) return 5;
+    throw std::runtime_error("exceeded maximum data length");
+}
+
+/* tree_encoded_size()
+ *
+ * Encoded size of an array or object, walked as walk_tree() would. A nested
+ * array or object whose size is already cached is not entered, and the size
+ * of each one entered is cached once its walk is done.
+ */
+inline size_t tree_encoded_size(TreeFrame frame) {
+    struct Open {
+        TreeFrame frame;
+        const MsgPackValue* value;
+        size_t start;
+    };
+    std::vector<Open> parents;
+    size_t ret = container_header_size(frame.items ? frame.count : frame.count / 2);
+    for (;;) {
+        if (frame.next == frame.count) {
+            if (parents.empty()) {
+                return ret;
             }
+            parents.back().value->set_encoded_size(ret - parents.back().start);
+            frame = parents.back().frame;
+            parents.pop_back();
+            continue;
         }
-    }
-    bool less(const MsgPackValue * other)   const override
-    {
-        switch( other->type() )
-        {
-            case MsgPack::INT64 :
-            {
-                return int64_value() < other->int64_value();
-            } break;
-            case MsgPack::UINT64 :
-            {
-                return less_int64_uint64( int64_value(), other->uint64_value() );
-            } break;
-            default :
-            {
-                return NumberValue<MsgPack::INT64, int64_t>::less( other );
-            }
+        const MsgPack& value = tree_item(frame, frame.next++);
+        MsgPack::Type const type = value.type();
+        if (type != MsgPack::ARRAY && type != MsgPack::OBJECT) {
+            ret += value.encoded_size();
+            continue;
         }
+        const MsgPackValue* const node = MsgPackValue::value_of(value);
+        size_t const cached = node->cached_encoded_size();
+        if (cached != MsgPackValue::unknown_size) {
+            ret += cached;
+            continue;
+        }
+        parents.push_back(Open{ frame, node, ret });
+        if (type == MsgPack::ARRAY) {
+            ret += container_header_size(value.array_items().size());
+            frame = tree_frame(value.array_items());
+        } else {
+            ret += container_header_size(value.object_items().size());
+            frame = tree_frame(value.object_items());
+        }
+    }
+}
+
+inline size_t encoded_size(const MsgPack::array& value) {
+    return tree_encoded_size(tree_frame(value));
+}
+
+inline size_t encoded_size(const MsgPack::object& value) {
+    return tree_encoded_size(tree_frame(value));
+}
+
+inline size_t binary_encoded_size(size_t len) {
+    if(len <= 0xff) return 2 + len;
+    else if(len <= 0xffff) return 3 + len;
+    else if(len <= 0xffffffff) return 5 + len;
+    throw std::runtime_error("exceeded maximum data length");
+}
+
+inline size_t encoded_size(const MsgPack::binary& value) {
+    return binary_encoded_size(value.size());
+}
+
+inline size_t extension_encoded_size(size_t len) {
+    switch(len) {
+        case 0x01: case 0x02: case 0x04: case 0x08: case 0x10:
+            return 2 + len;
+        default:
+            break;
+    }
+    if(len <= 0xff) return 3 + len;
+    else if(len <= 0xffff) return 4 + len;
+    else if(len <= 0xffffffff) return 6 + len;
+    throw std::runtime_error("exceeded maximum data length");
+}
+
+inline size_t encoded_size(const MsgPack::extension& value) {
+    return extension_encoded_size(std::get<1>( value ).size());
+}
+
+/* dump_scalar(), scalar_encoded_size()
+ *
+ * Serialize or size one of the types held inline in MsgPack.
+ */
+template< typename Buffer >
+void dump_scalar(const MsgPack& value, Buffer& out) {
+    switch (value.type()) {
+        case MsgPack::BOOL:    dump(value.bool_value(), out); break;
+        case MsgPack::FLOAT32: dump(value.float32_value(), out); break;
+        case MsgPack::FLOAT64: dump(value.float64_value(), out); break;
+        case MsgPack::INT8:    dump(value.int8_value(), out); break;
+        case MsgPack::INT16:   dump(value.int16_value(), out); break;
+        case MsgPack::INT32:   dump(value.int32_value(), out); break;
+        case MsgPack::INT64:   dump(value.int64_value(), out); break;
+        case MsgPack::UINT8:   dump(value.uint8_value(), out); break;
+        case MsgPack::UINT16:  dump(value.uint16_value(), out); break;
+        case MsgPack::UINT32:  dump(value.uint32_value(), out); break;
+        case MsgPack::UINT64:  dump(value.uint64_value(), out); break;
+        default:               dump(NullStruct(), out); break;
+    }
+}
+
+// Serialize any value, inline or not.
+template< typename Buffer >
+void dump_value(const MsgPack& value, Buffer& out) {
+    const MsgPackValue* const node = MsgPackValue::value_of(value);
+    if (node == nullptr) {
+        dump_scalar(value, out);
+    } else {
+        node->dump(out);
+    }
+}
+
+inline size_t scalar_encoded_size(const MsgPack& value) {
+    switch (value.type()) {
+        case MsgPack::BOOL:    return encoded_size(value.bool_value());
+        case MsgPack::FLOAT32: return encoded_size(value.float32_value());
+        case MsgPack::FLOAT64: return encoded_size(value.float64_value());
+        case MsgPack::INT8:    return encoded_size(value.int8_value());
+        case MsgPack::INT16:   return encoded_size(value.int16_value());
+        case MsgPack::INT32:   return encoded_size(value.int32_value());
+        case MsgPack::INT64:   return encoded_size(value.int64_value());
+        case MsgPack::UINT8:   return encoded_size(value.uint8_value());
+        case MsgPack::UINT16:  return encoded_size(value.uint16_value());
+        case MsgPack::UINT32:  return encoded_size(value.uint32_value());
+        case MsgPack::UINT64:  return encoded_size(value.uint64_value());
+        default:               return encoded_size(NullStruct());
+    }
+}
+}
+
+size_t MsgPack::encoded_size() const {
+    return is_inline() ? scalar_encoded_size(*this) : m_ptr->encoded_size();
+}
+
+void MsgPack::dump(std::string &out) const {
+    out.clear();
+    out.reserve(encoded_size());
+    dump_append(out);
+}
+
+void MsgPack::dump(binary &out) const {
+    out.clear();
+    out.reserve(encoded_size());
+    dump_append(out);
+}
+
+std::string MsgPack::dump() const {
+    std::string out;
+    out.reserve(encoded_size());
+    dump_append(out);
+    return out;
+}
+
+void MsgPack::dump_append(std::string &out) const {
+    dump_value(*this, out);
+}
+
+void MsgPack::dump_append(binary &out) const {
+    dump_value(*this, out);
+}
+
+namespace {
+inline size_t item_encoded_size(const MsgPack& item) {
+    return item.encoded_size();
+}
+
+inline size_t item_encoded_size(const MsgPack::object::value_type& item) {
+    return item.first.encoded_size() + item.second.encoded_size();
+}
+
+inline void dump_item(const MsgPack& item, RawBuffer& out) {
+    dump_value(item, out);
+}
+
+inline void dump_item(const MsgPack::object::value_type& item, RawBuffer& out) {
+    dump_value(item.first, out);
+    dump_value(item.second, out);
+}
+
+/* dump_items()
+ *
+ * Append the encoding of the elements of an array or the pairs of an object
+ * to out, split into chunks runs of equal count. Each chunk is sized on a
+ * thread of its own, and once out has room for all of them, encoded on that
+ * thread straight into its place in out.
+ */
+template< typename It, typename Buffer >
+void dump_items(It items, size_t count, size_t chunks, Buffer& out) {
+    // offsets[i] is where chunk i starts in out, offsets[chunks] the end.
+    std::vector<size_t> offsets(chunks + 1);
+    run_chunks(chunks, [items, count, chunks, &offsets](size_t chunk) {
+        It const last = items + count * (chunk + 1) / chunks;
+        size_t size = 0;
+        for (It it = items + count * chunk / chunks; it != last; ++it) {
+            size += item_encoded_size(*it);
+        }
+        offsets[chunk + 1] = size;
+    });
+    offsets[0] = out.size();
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        offsets[chunk + 1] += offsets[chunk];
+    }
+
+    out.resize(offsets[chunks]);
+    uint8_t* const base = reinterpret_cast<uint8_t*>(&out[0]);
+    run_chunks(chunks, [items, count, chunks, &offsets, base](size_t chunk) {
+        It const last = items + count * (chunk + 1) / chunks;
+        RawBuffer part{ base + offsets[chunk] };
+        for (It it = items + count * chunk / chunks; it != last; ++it) {
+            dump_item(*it, part);
+        }
+    });
+}
+
+/* dump_parallel()
+ *
+ * Replace out with the encoding of value, using up to threads threads for
+ * the elements of a large top-level array or object.
+ */
+template< typename Buffer >
+void dump_parallel(const MsgPack& value, Buffer& out, unsigned threads) {
+    out.clear();
+    size_t const count = value.is_array() ? value.array_items().size() : value.object_items().size();
+    size_t const chunks = std::min<size_t>(thread_count(threads), count / min_parallel_items);
+    if (chunks <= 1) {
+        out.reserve(value.encoded_size());
+        value.dump_append(out);
+    } else if (value.is_array()) {
+        dump_array_header(count, out);
+        dump_items(value.array_items().begin(), count, chunks, out);
+    } else {
+        dump_object_header(count, out);
+        dump_items(value.object_items().begin(), count, chunks, out);
+    }
+}
+}
+
+void MsgPack::dump(std::string &out, unsigned threads) const {
+    dump_parallel(*this, out, threads);
+}
+
+void MsgPack::dump(binary &out, unsigned threads) const {
+    dump_parallel(*this, out, threads);
+}
+
+std::ostream& operator<<(std::ostream& os, const MsgPack& msgpack) {
+    std::string out;
+    msgpack.dump_append(out);
+    os.write(out.data(), out.size());
+    return os;
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * MsgPackWriter
+ */
+
+MsgPackWriter::MsgPackWriter(std::string & out) : m_string(&out), m_binary(nullptr) {}
+MsgPackWriter::MsgPackWriter(MsgPack::binary & out) : m_string(nullptr), m_binary(&out) {}
+
+template< typename T >
+void MsgPackWriter::put(const T & value) {
+    if (m_string) {
+        msgpack11::dump(value, *m_string);
+    } else {
+        msgpack11::dump(value, *m_binary);
+    }
+}
+
+void MsgPackWriter::begin_array(size_t n) {
+    if (m_string) {
+        dump_array_header(n, *m_string);
+    } else {
+        dump_array_header(n, *m_binary);
+    }
+}
+
+void MsgPackWriter::begin_map(size_t n) {
+    if (m_string) {
+        dump_object_header(n, *m_string);
+    } else {
+        dump_object_header(n, *m_binary);
+    }
+}
+
+void MsgPackWriter::write_nil()        { put(NullStruct()); }
+void MsgPackWriter::write(bool value)     { put(value); }
+void MsgPackWriter::write(float value)    { put(value); }
+void MsgPackWriter::write(double value)   { put(value); }
+void MsgPackWriter::write(int8_t value)   { put(value); }
+void MsgPackWriter::write(int16_t value)  { put(value); }
+void MsgPackWriter::write(int32_t value)  { put(value); }
+void MsgPackWriter::write(int64_t value)  { put(value); }
+void MsgPackWriter::write(uint8_t value)  { put(value); }
+void MsgPackWriter::write(uint16_t value) { put(value); }
+void MsgPackWriter::write(uint32_t value) { put(value); }
+void MsgPackWriter::write(uint64_t value) { put(value); }
+
+void MsgPackWriter::write(const MsgPack & value) {
+    if (m_string) {
+        value.dump_append(*m_string);
+    } else {
+        value.dump_append(*m_binary);
+    }
+}
+
+void MsgPackWriter::write_str(const char * data, size_t len) {
+    const uint8_t* const bytes = reinterpret_cast<const uint8_t*>(data);
+    if (m_string) {
+        dump_string(bytes, len, *m_string);
+    } else {
+        dump_string(bytes, len, *m_binary);
+    }
+}
+
+void MsgPackWriter::write_str(const std::string & value) {
+    write_str(value.data(), value.size());
+}
+
+void MsgPackWriter::write_bin(const uint8_t * data, size_t len) {
+    if (m_string) {
+        dump_binary(data, len, *m_string);
+    } else {
+        dump_binary(data, len, *m_binary);
+    }
+}
+
+void MsgPackWriter::write_ext(int8_t type, const uint8_t * data, size_t len) {
+    if (m_string) {
+        dump_extension(type, data, len, *m_string);
+    } else {
+        dump_extension(type, data, len, *m_binary);
+    }
+}
+
+void MsgPackWriter::write(const MsgPack::timestamp & value) { put(value); }
+
+template< typename T >
+void MsgPackWriter::put_array(const T * data, size_t n) {
+    if (m_string) {
+        dump_number_array(data, n, *m_string);
+    } else {
+        dump_number_array(data, n, *m_binary);
+    }
+}
+
+void MsgPackWriter::write_array(const float * data, size_t n)    { put_array(data, n); }
+void MsgPackWriter::write_array(const double * data, size_t n)   { put_array(data, n); }
+void MsgPackWriter::write_array(const int8_t * data, size_t n)   { put_array(data, n); }
+void MsgPackWriter::write_array(const int16_t * data, size_t n)  { put_array(data, n); }
+void MsgPackWriter::write_array(const int32_t * data, size_t n)  { put_array(data, n); }
+void MsgPackWriter::write_array(const int64_t * data, size_t n)  { put_array(data, n); }
+void MsgPackWriter::write_array(const uint8_t * data, size_t n)  { put_array(data, n); }
+void MsgPackWriter::write_array(const uint16_t * data, size_t n) { put_array(data, n); }
+void MsgPackWriter::write_array(const uint32_t * data, size_t n) { put_array(data, n); }
+void MsgPackWriter::write_array(const uint64_t * data, size_t n) { put_array(data, n); }
+
+size_t MsgPackWriter::size() const {
+    return m_string ? m_string->size() : m_binary->size();
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Value wrappers
+ */
+
+template <MsgPack::Type tag, typename T>
+class Value : public MsgPackValue {
+protected:
+
+    // Constructors
+    explicit Value(const T &value) : m_value(value) {}
+    explicit Value(T &&value)      : m_value(std::move(value)) {}
+
+    // Get type tag
+    MsgPack::Type type() const override {
+        return tag;
+    }
+
+    // Comparisons
+    bool equals(const MsgPackValue * other) const override {
+        bool const is_same_type = tag == other->type();
+        return is_same_type && (m_value == static_cast<const Value<tag, T> *>(other)->m_value);
+    }
+    bool less(const MsgPackValue * other) const override {
+        bool const is_same_type = tag == other->type();
+        bool const is_less_type = tag < other->type();
+        return is_less_type || (is_same_type && (m_value < static_cast<const Value<tag, T> *>(other)->m_value));
+    }
+
+    const T m_value;
+    void dump(std::string& out) const override { msgpack11::dump(m_value, out); }
+    void dump(MsgPack::binary& out) const override { msgpack11::dump(m_value, out); }
+    void dump(RawBuffer& out) const override { msgpack11::dump(m_value, out); }
+    size_t encoded_size() const override { return msgpack11::encoded_size(m_value); }
+};
+
+/* CachedSizeValue
+ *
+ * Containers are immutable once built, so their encoded size is computed on
+ * first use and then reused. They compare with compare_trees(), which does
+ * not recurse into nested containers.
+ */
+template <MsgPack::Type tag, typename T>
+class CachedSizeValue : public Value<tag, T> {
+protected:
+    explicit CachedSizeValue(const T &value) : Value<tag, T>(value), m_encoded_size(MsgPackValue::unknown_size) {}
+    explicit CachedSizeValue(T &&value)      : Value<tag, T>(std::move(value)), m_encoded_size(MsgPackValue::unknown_size) {}
+
+    bool equals(const MsgPackValue * other) const override {
+        return tag == other->type() && compare_trees(tree_frame(this->m_value), tree_frame(items_of(other)), false) == 0;
+    }
+    bool less(const MsgPackValue * other) const override {
+        if (tag != other->type()) {
+            return tag < other->type();
+        }
+        return compare_trees(tree_frame(this->m_value), tree_frame(items_of(other)), true) < 0;
+    }
+
+    size_t encoded_size() const override {
+        size_t ret = m_encoded_size.load(std::memory_order_relaxed);
+        if (ret == MsgPackValue::unknown_size) {
+            ret = Value<tag, T>::encoded_size();
+            m_encoded_size.store(ret, std::memory_order_relaxed);
+        }
+        return ret;
+    }
+    size_t cached_encoded_size() const override { return m_encoded_size.load(std::memory_order_relaxed); }
+    void set_encoded_size(size_t size) const override { m_encoded_size.store(size, std::memory_order_relaxed); }
+
+private:
+    static const T &items_of(const MsgPackValue * other) {
+        return static_cast<const CachedSizeValue *>(other)->m_value;
+    }
+
+    mutable std::atomic<size_t> m_encoded_size;
+};
+
+/* release_items()
+ *
+ * Destroy the elements of an array or object being destroyed without
+ * recursing once per level of nesting. The outermost container destroyed on
+ * a thread drains a list of the items of the containers destroyed under it,
+ * which hand their items over instead of destroying them, so each level is
+ * released from the same loop. A container holding only scalars or shared
+ * values adds nothing to the list and allocates nothing.
+ */
+struct PendingRelease {
+    std::vector<MsgPack::array> arrays;
+    std::vector<MsgPack::object> objects;
+
+    void add(MsgPack::array&& items) { arrays.push_back(std::move(items)); }
+    void add(MsgPack::object&& items) { objects.push_back(std::move(items)); }
+};
+
+thread_local PendingRelease* pending_release = nullptr;
+
+template <typename Items>
+void release_items(Items& items) {
+    if (items.empty()) {
+        return;
+    }
+    if (pending_release != nullptr) {
+        try {
+            pending_release->add(std::move(items));
+        } catch (...) {
+            // Out of memory: destroy the items in place, recursing after all.
+        }
+        return;
+    }
+
+    PendingRelease pending;
+    pending_release = &pending;
+    items.clear();
+    while (!pending.arrays.empty() || !pending.objects.empty()) {
+        if (!pending.arrays.empty()) {
+            MsgPack::array const next(std::move(pending.arrays.back()));
+            pending.arrays.pop_back();
+        } else {
+            MsgPack::object const next(std::move(pending.objects.back()));
+            pending.objects.pop_back();
+        }
+    }
+    pending_release = nullptr;
+}
+
+bool equal_uint64_int64( uint64_t uint64_value, int64_t int64_value )
+{
+    bool const is_positive = 0 <= int64_value;
+    bool const is_leq_int64_max = uint64_value <= static_cast<std::uint64_t>(std::numeric_limits<int64_t>::max());
+    return is_positive && is_leq_int64_max && ( uint64_value == static_cast<uint64_t>(int64_value));
+}
+
+bool less_uint64_int64( uint64_t uint64_value, int64_t int64_value )
+{
+    bool const is_positive = 0 <= int64_value;
+    bool const is_leq_int64_max = uint64_value <= static_cast<std::uint64_t>(std::numeric_limits<int64_t>::max());
+    return is_positive && is_leq_int64_max && ( uint64_value < static_cast<uint64_t>(int64_value));
+}
+
+bool less_int64_uint64( int64_t int64_value, uint64_t uint64_value )
+{
+    bool const is_negative = int64_value < 0;
+    bool const is_gt_int64_max = static_cast<std::uint64_t>(std::numeric_limits<int64_t>::max()) < uint64_value;
+    return is_negative || is_gt_int64_max || ( static_cast<uint64_t>(int64_value) < uint64_value );
+}
+
+class MsgPackString final : public Value<MsgPack::STRING, string> {
+    const string &string_value() const override { return m_value; }
+    const uint8_t *payload_data() const override { return reinterpret_cast<const uint8_t*>(m_value.data()); }
+    size_t payload_size() const override { return m_value.size(); }
+public:
+    explicit MsgPackString(const string &value) : Value(value) {}
+    explicit MsgPackString(string &&value)      : Value(std::move(value)) {}
+};
+
+class MsgPackArray final : public CachedSizeValue<MsgPack::ARRAY, MsgPack::array> {
+    const MsgPack::array &array_items() const override { return m_value; }
+    const MsgPack & operator[](size_t i) const override;
+public:
+    explicit MsgPackArray(const MsgPack::array &value) : CachedSizeValue(value) {}
+    explicit MsgPackArray(MsgPack::array &&value)      : CachedSizeValue(std::move(value)) {}
+    // The elements are no longer const once destruction has begun.
+    ~MsgPackArray() override { release_items(const_cast<MsgPack::array &>(m_value)); }
+};
+
+class MsgPackBinary final : public Value<MsgPack::BINARY, MsgPack::binary> {
+    const MsgPack::binary &binary_items() const override { return m_value; }
+    const uint8_t *payload_data() const override { return m_value.data(); }
+    size_t payload_size() const override { return m_value.size(); }
+public:
+    explicit MsgPackBinary(const MsgPack::binary &value) : Value(value) {}
+    explicit MsgPackBinary(MsgPack::binary &&value)      : Value(std::move(value)) {}
+};
+
+class MsgPackObject final : public CachedSizeValue<MsgPack::OBJECT, MsgPack::object> {
+    const MsgPack::object &object_items() const override { return m_value; }
+    const MsgPack & get(const char *key, size_t len) const override;
+public:
+    explicit MsgPackObject(const MsgPack::object &value) : CachedSizeValue(value) {}
+    explicit MsgPackObject(MsgPack::object &&value)      : CachedSizeValue(std::move(value)) {}
+    ~MsgPackObject() override { release_items(const_cast<MsgPack::object &>(m_value)); }
+};
+
+class MsgPackExtension final : public Value<MsgPack::EXTENSION, MsgPack::extension> {
+    const MsgPack::extension &extension_items() const override { return m_value; }
+    // The other EXTENSION may be a MsgPackNativeExtension.
+    bool equals(const MsgPackValue * other) const override {
+        return MsgPack::EXTENSION == other->type() && m_value == other->extension_items();
+    }
+    bool less(const MsgPackValue * other) const override {
+        if (MsgPack::EXTENSION != other->type()) {
+            return MsgPack::EXTENSION < other->type();
+        }
+        return m_value < other->extension_items();
+    }
+public:
+    explicit MsgPackExtension(const MsgPack::extension &value) : Value(value) {}
+    explicit MsgPackExtension(MsgPack::extension &&value)      : Value(std::move(value)) {}
+};
+
+/* BorrowedValue
+ *
+ * STRING or BINARY whose bytes stay in the parse input. The input owner, if
+ * any, is kept alive with the value. string_value() and binary_items() need
+ * an owned container, so the first call makes a copy that later calls reuse.
+ */
+int compare_bytes(const uint8_t* lhs, size_t lhs_len, const uint8_t* rhs, size_t rhs_len) {
+    size_t const len = std::min(lhs_len, rhs_len);
+    int const ret = (len == 0) ? 0 : std::memcmp(lhs, rhs, len);
+    if (ret != 0) {
+        return ret;
+    }
+    return (lhs_len < rhs_len) ? -1 : ((rhs_len < lhs_len) ? 1 : 0);
+}
+
+template <MsgPack::Type tag, typename T>
+class BorrowedValue : public MsgPackValue {
+protected:
+    BorrowedValue(const uint8_t* data, size_t len, std::shared_ptr<const void> owner)
+        : m_data(data), m_len(len), m_owner(std::move(owner)), m_copy(nullptr) {}
+    ~BorrowedValue() { delete m_copy.load(std::memory_order_relaxed); }
+
+    MsgPack::Type type() const override { return tag; }
+    const uint8_t *payload_data() const override { return m_data; }
+    size_t payload_size() const override { return m_len; }
+
+    bool equals(const MsgPackValue * other) const override {
+        return tag == other->type() &&
+            compare_bytes(m_data, m_len, other->payload_data(), other->payload_size()) == 0;
+    }
+    bool less(const MsgPackValue * other) const override {
+        if (tag != other->type()) {
+            return tag < other->type();
+        }
+        return compare_bytes(m_data, m_len, other->payload_data(), other->payload_size()) < 0;
+    }
+
+    const T &copy() const {
+        T* ret = m_copy.load(std::memory_order_acquire);
+        if (ret == nullptr) {
+            T* const created = new T(m_data, m_data + m_len);
+            if (m_copy.compare_exchange_strong(ret, created, std::memory_order_acq_rel)) {
+                ret = created;
+            } else {
+                delete created;
+            }
+        }
+        return *ret;
+    }
+
+    const uint8_t* const m_data;
+    size_t const m_len;
+
+private:
+    std::shared_ptr<const void> const m_owner;
+    mutable std::atomic<T*> m_copy;
+};
+
+class MsgPackBorrowedString final : public BorrowedValue<MsgPack::STRING, string> {
+    const string &string_value() const override { return copy(); }
+    void dump(std::string& out) const override { dump_string(m_data, m_len, out); }
+    void dump(MsgPack::binary& out) const override { dump_string(m_data, m_len, out); }
+    void dump(RawBuffer& out) const override { dump_string(m_data, m_len, out); }
+    size_t encoded_size() const override { return string_encoded_size(m_len); }
+public:
+    MsgPackBorrowedString(const uint8_t* data, size_t len, std::shared_ptr<const void> owner)
+        : BorrowedValue(data, len, std::move(owner)) {}
+};
+
+class MsgPackBorrowedBinary final : public BorrowedValue<MsgPack::BINARY, MsgPack::binary> {
+    const MsgPack::binary &binary_items() const override { return copy(); }
+    void dump(std::string& out) const override { dump_binary(m_data, m_len, out); }
+    void dump(MsgPack::binary& out) const override { dump_binary(m_data, m_len, out); }
+    void dump(RawBuffer& out) const override { dump_binary(m_data, m_len, out); }
+    size_t encoded_size() const override { return binary_encoded_size(m_len); }
+public:
+    MsgPackBorrowedBinary(const uint8_t* data, size_t len, std::shared_ptr<const void> owner)
+        : BorrowedValue(data, len, std::move(owner)) {}
+};
+
+MsgPackExtensionCodec::MsgPackExtensionCodec(int8_t type, size_t value_size)
+    : m_type(type), m_value_size(value_size) {
+    if (value_size > max_value_size) {
+        throw std::invalid_argument("extension codec value size exceeds max_value_size");
+    }
+}
+
+/* MsgPackNativeExtension
+ *
+ * EXTENSION held as the native value of its codec rather than as its
+ * payload; the payload is encoded again whenever it is needed.
+ * extension_items() needs an owned tuple, so the first call encodes one that
+ * later calls reuse.
+ */
+class MsgPackNativeExtension final : public MsgPackValue {
+public:
+    MsgPackNativeExtension(const MsgPackExtensionCodec& codec, const void* value)
+        : m_codec(codec), m_items(nullptr) {
+        std::memcpy(m_value, value, codec.value_size());
+    }
+    ~MsgPackNativeExtension() { delete m_items.load(std::memory_order_relaxed); }
+
+private:
+    MsgPack::Type type() const override { return MsgPack::EXTENSION; }
+
+    bool equals(const MsgPackValue * other) const override {
+        return MsgPack::EXTENSION == other->type() && extension_items() == other->extension_items();
+    }
+    bool less(const MsgPackValue * other) const override {
+        if (MsgPack::EXTENSION != other->type()) {
+            return MsgPack::EXTENSION < other->type();
+        }
+        return extension_items() < other->extension_items();
+    }
+
+    void dump(std::string& out) const override { dump_native(out); }
+    void dump(MsgPack::binary& out) const override { dump_native(out); }
+    void dump(RawBuffer& out) const override { dump_native(out); }
+    size_t encoded_size() const override {
+        uint8_t payload[MsgPackExtensionCodec::max_payload_size];
+        return extension_encoded_size(m_codec.encode(m_value, payload));
+    }
+
+    const MsgPack::extension &extension_items() const override {
+        MsgPack::extension* ret = m_items.load(std::memory_order_acquire);
+        if (ret == nullptr) {
+            uint8_t payload[MsgPackExtensionCodec::max_payload_size];
+            size_t const len = m_codec.encode(m_value, payload);
+            MsgPack::extension* const created =
+                new MsgPack::extension(m_codec.type(), MsgPack::binary(payload, payload + len));
+            if (m_items.compare_exchange_strong(ret, created, std::memory_order_acq_rel)) {
+                ret = created;
+            } else {
+                delete created;
+            }
+        }
+        return *ret;
+    }
+
+    const void *native_value(const MsgPackExtensionCodec & codec) const override {
+        return (&codec == &m_codec) ? m_value : nullptr;
+    }
+
+    template< typename Buffer >
+    void dump_native(Buffer& out) const {
+        uint8_t payload[MsgPackExtensionCodec::max_payload_size];
+        dump_extension(m_codec.type(), payload, m_codec.encode(m_value, payload), out);
+    }
+
+    const MsgPackExtensionCodec& m_codec;
+    alignas(MsgPackExtensionCodec::max_value_align) unsigned char m_value[MsgPackExtensionCodec::max_value_size];
+    mutable std::atomic<MsgPack::extension*> m_items;
+};
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Static globals - static-init-safe
+ */
+struct Statics {
+    const string empty_string;
+    const vector<MsgPack> empty_vector;
+    const MsgPack::object empty_map;
+    const MsgPack::binary empty_binary;
+    const MsgPack::extension empty_extension;
+    Statics() {}
+};
+
+static const Statics & statics() {
+    static const Statics s {};
+    return s;
+}
+
+static const MsgPack & static_null() {
+    static const MsgPack msgpack_null;
+    return msgpack_null;
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Constructors
+ */
+
+MsgPack::MsgPack() noexcept                        : m_type(NUL), m_uint(0) {}
+MsgPack::MsgPack(std::nullptr_t) noexcept          : m_type(NUL), m_uint(0) {}
+MsgPack::MsgPack(float value)                      : m_type(FLOAT32), m_uint(0) { m_float32 = value; }
+MsgPack::MsgPack(double value)                     : m_type(FLOAT64), m_float64(value) {}
+MsgPack::MsgPack(int8_t value)                     : m_type(INT8), m_int(value) {}
+MsgPack::MsgPack(int16_t value)                    : m_type(INT16), m_int(value) {}
+MsgPack::MsgPack(int32_t value)                    : m_type(INT32), m_int(value) {}
+MsgPack::MsgPack(int64_t value)                    : m_type(INT64), m_int(value) {}
+MsgPack::MsgPack(uint8_t value)                    : m_type(UINT8), m_uint(value) {}
+MsgPack::MsgPack(uint16_t value)                   : m_type(UINT16), m_uint(value) {}
+MsgPack::MsgPack(uint32_t value)                   : m_type(UINT32), m_uint(value) {}
+MsgPack::MsgPack(uint64_t value)                   : m_type(UINT64), m_uint(value) {}
+MsgPack::MsgPack(bool value)                       : m_type(BOOL), m_uint(0) { m_bool = value; }
+MsgPack::MsgPack(const string &value)              : MsgPack(new MsgPackString(value)) {}
+MsgPack::MsgPack(string &&value)                   : MsgPack(new MsgPackString(std::move(value))) {}
+MsgPack::MsgPack(const char * value)               : MsgPack(new MsgPackString(value)) {}
+MsgPack::MsgPack(const MsgPack::array &values)     : MsgPack(new MsgPackArray(values)) {}
+MsgPack::MsgPack(MsgPack::array &&values)          : MsgPack(new MsgPackArray(std::move(values))) {}
+MsgPack::MsgPack(const MsgPack::object &values)    : MsgPack(new MsgPackObject(values)) {}
+MsgPack::MsgPack(MsgPack::object &&values)         : MsgPack(new MsgPackObject(std::move(values))) {}
+MsgPack::MsgPack(const MsgPack::binary &values)    : MsgPack(new MsgPackBinary(values)) {}
+MsgPack::MsgPack(MsgPack::binary &&values)         : MsgPack(new MsgPackBinary(std::move(values))) {}
+MsgPack::MsgPack(const MsgPack::extension &values) : MsgPack(new MsgPackExtension(values)) {}
+MsgPack::MsgPack(MsgPack::extension &&values)      : MsgPack(new MsgPackExtension(std::move(values))) {}
+// Held as the native value of the timestamp codec, with no payload copy.
+MsgPack::MsgPack(const MsgPack::timestamp &value)  : MsgPack(make_extension(normalize_timestamp(value))) {}
+
+MsgPack::MsgPack(MsgPackValue *value) noexcept : m_type(value->type()), m_ptr(value) {}
+
+MsgPack::MsgPack(const MsgPackExtensionCodec &codec, const void *value)
+    : MsgPack(new MsgPackNativeExtension(codec, value)) {}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Copy, move and destruction
+ *
+ * Scalars are copied as the raw 8 bytes of the union; only heap values need
+ * their reference count updated.
+ */
+
+MsgPack::MsgPack(const MsgPack &other) noexcept : m_type(other.m_type) {
+    if (is_inline()) {
+        m_uint = other.m_uint;
+    } else {
+        m_ptr = other.m_ptr;
+        m_ptr->retain();
+    }
+}
+
+MsgPack::MsgPack(MsgPack &&other) noexcept : m_type(other.m_type) {
+    if (is_inline()) {
+        m_uint = other.m_uint;
+    } else {
+        m_ptr = other.m_ptr;
+        // Leave the source as a valid NUL rather than a dangling heap type.
+        other.m_type = NUL;
+        other.m_uint = 0;
+    }
+}
+
+// other may be owned by the value being replaced (e.g. v = v[0]), so it is
+// taken before the old value is released.
+MsgPack & MsgPack::operator=(const MsgPack &other) noexcept {
+    if (!is_inline() && !other.is_inline()) {
+        MsgPackValue * const old = m_ptr;
+        other.m_ptr->retain();
+        m_type = other.m_type;
+        m_ptr = other.m_ptr;
+        old->release();
+    } else if (this != &other) {
+        *this = MsgPack(other);
+    }
+    return *this;
+}
+
+MsgPack & MsgPack::operator=(MsgPack &&other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    Type const type = other.m_type;
+    if (other.is_inline()) {
+        uint64_t const bits = other.m_uint;
+        this->~MsgPack();
+        m_type = type;
+        m_uint = bits;
+        return *this;
+    }
+    // Move the pointer out explicitly, leaving other a valid NUL, and release
+    // the old value only once it is no longer needed.
+    MsgPackValue * const old = is_inline() ? nullptr : m_ptr;
+    m_ptr = other.m_ptr;
+    m_type = type;
+    other.m_type = NUL;
+    other.m_uint = 0;
+    if (old != nullptr) {
+        old->release();
+    }
+    return *this;
+}
+
+MsgPack::~MsgPack() {
+    if (!is_inline()) {
+        m_ptr->release();
+    }
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Accessors
+ */
+
+// Convert an inline number to T the way static_cast does, or return 0 if this
+// is not a number.
+template< typename T >
+T MsgPack::number_as() const {
+    switch (m_type) {
+        case FLOAT32: return static_cast<T>(m_float32);
+        case FLOAT64: return static_cast<T>(m_float64);
+        case INT8:    // fall through
+        case INT16:   // fall through
+        case INT32:   // fall through
+        case INT64:   return static_cast<T>(m_int);
+        case UINT8:   // fall through
+        case UINT16:  // fall through
+        case UINT32:  // fall through
+        case UINT64:  return static_cast<T>(m_uint);
+        default:      return 0;
+    }
+}
+
+MsgPack::Type MsgPack::type()                           const { return m_type; }
+double MsgPack::number_value()                          const { return number_as<double>(); }
+float MsgPack::float32_value()                          const { return number_as<float>(); }
+double MsgPack::float64_value()                         const { return number_as<double>(); }
+int32_t MsgPack::int_value()                            const { return number_as<int32_t>(); }
+int8_t MsgPack::int8_value()                            const { return number_as<int8_t>(); }
+int16_t MsgPack::int16_value()                          const { return number_as<int16_t>(); }
+int32_t MsgPack::int32_value()                          const { return number_as<int32_t>(); }
+int64_t MsgPack::int64_value()                          const { return number_as<int64_t>(); }
+uint8_t MsgPack::uint8_value()                          const { return number_as<uint8_t>(); }
+uint16_t MsgPack::uint16_value()                        const { return number_as<uint16_t>(); }
+uint32_t MsgPack::uint32_value()                        const { return number_as<uint32_t>(); }
+uint64_t MsgPack::uint64_value()                        const { return number_as<uint64_t>(); }
+bool MsgPack::bool_value()                              const { return m_type == BOOL && m_bool; }
+const string & MsgPack::string_value()                  const { return is_inline() ? statics().empty_string : m_ptr->string_value(); }
+const vector<MsgPack>& MsgPack::array_items()           const { return is_inline() ? statics().empty_vector : m_ptr->array_items(); }
+const MsgPack::binary& MsgPack::binary_items()          const { return is_inline() ? statics().empty_binary : m_ptr->binary_items(); }
+const char * MsgPack::string_data()                     const { return m_type == STRING ? reinterpret_cast<const char*>(m_ptr->payload_data()) : nullptr; }
+size_t MsgPack::string_size()                           const { return m_type == STRING ? m_ptr->payload_size() : 0; }
+const uint8_t * MsgPack::binary_data()                  const { return m_type == BINARY ? m_ptr->payload_data() : nullptr; }
+size_t MsgPack::binary_size()                           const { return m_type == BINARY ? m_ptr->payload_size() : 0; }
+const MsgPack::extension& MsgPack::extension_items()    const { return is_inline() ? statics().empty_extension : m_ptr->extension_items(); }
+
+const void * MsgPack::native_value(const MsgPackExtensionCodec &codec) const {
+    return is_inline() ? nullptr : m_ptr->native_value(codec);
+}
+
+bool MsgPack::is_timestamp() const {
+    if (m_type != EXTENSION) {
+        return false;
+    }
+    if (extension_value<timestamp>() != nullptr) {
+        return true;
+    }
+    const extension& ext = m_ptr->extension_items();
+    timestamp value;
+    return std::get<0>(ext) == -1 && timestamp::decode(std::get<1>(ext).data(), std::get<1>(ext).size(), value);
+}
+
+MsgPack::timestamp MsgPack::timestamp_value() const {
+    // decode() leaves value alone unless the payload is a valid timestamp.
+    timestamp value = { 0, 0 };
+    if (const timestamp* const native = extension_value<timestamp>()) {
+        return *native;
+    }
+    if (m_type == EXTENSION) {
+        const extension& ext = m_ptr->extension_items();
+        if (std::get<0>(ext) == -1) {
+            timestamp::decode(std::get<1>(ext).data(), std::get<1>(ext).size(), value);
+        }
+    }
+    return value;
+}
+
+/* timestamp::encode()
+ *
+ * Use the smallest form that holds the value: 32 bit seconds, 30 bit
+ * nanoseconds packed above 34 bit seconds, or 32 bit nanoseconds followed by
+ * 64 bit signed seconds. Out of range nanoseconds are normalized first.
+ */
+size_t MsgPack::timestamp::encode(uint8_t * out) const {
+    timestamp const value = normalize_timestamp(*this);
+    if ((static_cast<uint64_t>(value.seconds) >> 34) == 0) {
+        uint64_t const packed = (static_cast<uint64_t>(value.nanoseconds) << 34) | static_cast<uint64_t>(value.seconds);
+        if ((packed >> 32) == 0) {
+            store_be(static_cast<uint32_t>(packed), out);
+            return 4;
+        }
+        store_be(packed, out);
+        return 8;
+    }
+    store_be(value.nanoseconds, out);
+    store_be(value.seconds, out + 4);
+    return 12;
+}
+
+bool MsgPack::timestamp::decode(const uint8_t * data, size_t len, timestamp & out) {
+    timestamp value;
+    if (len == 4) {
+        value.seconds = load_be<uint32_t>(data);
+        value.nanoseconds = 0;
+    } else if (len == 8) {
+        uint64_t const packed = load_be<uint64_t>(data);
+        value.seconds = static_cast<int64_t>(packed & 0x3ffffffffull);
+        value.nanoseconds = static_cast<uint32_t>(packed >> 34);
+    } else if (len == 12) {
+        value.nanoseconds = load_be<uint32_t>(data);
+        value.seconds = load_be<int64_t>(data + 4);
+    } else {
+        return false;
+    }
+    if (1000000000 <= value.nanoseconds) {
+        return false;
+    }
+    out = value;
+    return true;
+}
+const MsgPack::object & MsgPack::object_items()        const { return is_inline() ? statics().empty_map : m_ptr->object_items(); }
+const MsgPack & MsgPack::operator[] (size_t i)          const { return is_inline() ? static_null() : (*m_ptr)[i]; }
+const MsgPack & MsgPack::operator[] (const string &key) const { return get(key.data(), key.size()); }
+const MsgPack & MsgPack::get(const char *key, size_t len) const { return is_inline() ? static_null() : m_ptr->get(key, len); }
+#if __cplusplus >= 201703L
+const MsgPack & MsgPack::operator[] (std::string_view key) const { return get(key.data(), key.size()); }
+#endif
+
+const string &                MsgPackValue::string_value()              const { return statics().empty_string; }
+const vector<MsgPack> &       MsgPackValue::array_items()               const { return statics().empty_vector; }
+const MsgPack::object &       MsgPackValue::object_items()              const { return statics().empty_map; }
+const MsgPack::binary & MsgPackValue::binary_items()                    const { return statics().empty_binary; }
+const MsgPack::extension & MsgPackValue::extension_items()              const { return statics().empty_extension; }
+const MsgPack &               MsgPackValue::operator[] (size_t)         const { return static_null(); }
+const MsgPack &               MsgPackValue::get(const char *, size_t)   const { return static_null(); }
+
+const MsgPack & MsgPackObject::get(const char *key, size_t len) const {
+    auto iter = m_value.find(key, len);
+    return (iter == m_value.end()) ? static_null() : iter->second;
+}
+const MsgPack & MsgPackArray::operator[] (size_t i) const {
+    if (i >= m_value.size()) return static_null();
+    else return m_value[i];
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * MsgPack::object
+ */
+
+namespace {
+inline bool key_less(const MsgPack::object::value_type *item, const MsgPack &key) {
+    return item->first < key;
+}
+}
+
+MsgPack::object::object(std::vector<std::pair<MsgPack, MsgPack>> &&items) {
+    if (items.empty()) {
+        return;
+    }
+    m_index.reserve(items.size());
+    add_block(items.size());
+    Block &block = m_blocks.back();
+    for (auto &item : items) {
+        value_type *const slot = block.slots + block.used;
+        new (slot) value_type(std::move(item.first), std::move(item.second));
+        ++block.used;
+        m_index.push_back(slot);
+    }
+    // stable_sort keeps equal keys in input order, so the first one is kept.
+    std::stable_sort(m_index.begin(), m_index.end(), [](const value_type *a, const value_type *b) {
+        return a->first < b->first;
+    });
+    auto last = m_index.begin();
+    for (auto it = m_index.begin() + 1; it != m_index.end(); ++it) {
+        if ((*last)->first < (*it)->first) {
+            *++last = *it;
+        } else {
+            free_slot(*it);
+        }
+    }
+    m_index.erase(last + 1, m_index.end());
+}
+
+MsgPack::object::object(const object &other) {
+    if (other.empty()) {
+        return;
+    }
+    m_index.reserve(other.size());
+    add_block(other.size());
+    Block &block = m_blocks.back();
+    for (const value_type *item : other.m_index) {
+        value_type *const slot = block.slots + block.used;
+        new (slot) value_type(*item);
+        ++block.used;
+        m_index.push_back(slot);
+    }
+}
+
+void MsgPack::object::swap(object &other) noexcept {
+    m_index.swap(other.m_index);
+    m_blocks.swap(other.m_blocks);
+    m_free.swap(other.m_free);
+}
+
+void MsgPack::object::clear() noexcept {
+    for (value_type *item : m_index) {
+        item->~value_type();
+    }
+    for (const Block &block : m_blocks) {
+        std::allocator<value_type>().deallocate(block.slots, block.capacity);
+    }
+    m_index.clear();
+    m_blocks.clear();
+    m_free.clear();
+}
+
+void MsgPack::object::add_block(size_t capacity) {
+    m_blocks.reserve(m_blocks.size() + 1);
+    m_blocks.push_back(Block{ std::allocator<value_type>().allocate(capacity), 0, capacity });
+}
+
+MsgPack::object::value_type *MsgPack::object::new_slot() {
+    m_index.reserve(m_index.size() + 1);
+    if (!m_free.empty()) {
+        value_type *const slot = m_free.back();
+        m_free.pop_back();
+        return slot;
+    }
+    if (m_blocks.empty() || m_blocks.back().used == m_blocks.back().capacity) {
+        // Each block is as large as the map so far, so the blocks of a map
+        // built one key at a time stay logarithmic in number.
+        add_block(std::max<size_t>(size(), 4));
+    }
+    Block &block = m_blocks.back();
+    return block.slots + block.used++;
+}
+
+void MsgPack::object::free_slot(value_type *slot) noexcept {
+    slot->~value_type();
+    try {
+        m_free.push_back(slot);
+    } catch (...) {
+        // Out of memory: the slot is not reused, and is freed with its block.
+    }
+}
+
+template <class... Args>
+MsgPack::object::iterator MsgPack::object::emplace_at(const_iterator pos, Args &&... args) {
+    std::ptrdiff_t const index = pos - cbegin();
+    value_type *const slot = new_slot();
+    try {
+        new (slot) value_type(std::forward<Args>(args)...);
+    } catch (...) {
+        m_free.push_back(slot);
+        throw;
+    }
+    // new_slot() reserved room, so this does not throw.
+    m_index.insert(m_index.begin() + index, slot);
+    return begin() + index;
+}
+
+MsgPack::object::iterator MsgPack::object::lower_bound(const MsgPack &key) {
+    return iterator(std::lower_bound(m_index.data(), m_index.data() + m_index.size(), key, key_less));
+}
+
+MsgPack::object::const_iterator MsgPack::object::lower_bound(const MsgPack &key) const {
+    return const_iterator(std::lower_bound(m_index.data(), m_index.data() + m_index.size(), key, key_less));
+}
+
+namespace {
+/* StringKey
+ *
+ * A string key compared against object keys in MsgPack order: every key of a
+ * type below STRING sorts before it, every key of a type above after it, and
+ * string keys compare like std::string.
+ */
+struct StringKey {
+    const char *data;
+    size_t len;
+
+    // Return <0, 0 or >0 as key sorts before, equal to or after this string.
+    int compare(const MsgPack &key) const {
+        if (key.type() != MsgPack::STRING) {
+            return key.type() < MsgPack::STRING ? -1 : 1;
+        }
+        return compare_bytes(reinterpret_cast<const uint8_t*>(key.string_data()), key.string_size(),
+                             reinterpret_cast<const uint8_t*>(data), len);
+    }
+};
+}
+
+MsgPack::object::iterator MsgPack::object::find(const char *key, size_t len) {
+    const_iterator const iter = static_cast<const object &>(*this).find(key, len);
+    return begin() + (iter - cbegin());
+}
+
+MsgPack::object::const_iterator MsgPack::object::find(const char *key, size_t len) const {
+    StringKey const string_key { key, len };
+    const_iterator const iter(std::lower_bound(m_index.data(), m_index.data() + m_index.size(), string_key,
+        [](const value_type *item, const StringKey &k) { return k.compare(item->first) < 0; }));
+    return (iter == end() || string_key.compare(iter->first) != 0) ? end() : iter;
+}
+
+MsgPack::object::iterator MsgPack::object::find(const MsgPack &key) {
+    iterator const iter = lower_bound(key);
+    return (iter == end() || key < iter->first) ? end() : iter;
+}
+
+MsgPack::object::const_iterator MsgPack::object::find(const MsgPack &key) const {
+    const_iterator const iter = lower_bound(key);
+    return (iter == end() || key < iter->first) ? end() : iter;
+}
+
+std::pair<MsgPack::object::iterator, bool> MsgPack::object::insert(const value_type &value) {
+    iterator const iter = lower_bound(value.first);
+    if (iter != end() && !(value.first < iter->first)) {
+        return std::make_pair(iter, false);
+    }
+    return std::make_pair(emplace_at(iter, value), true);
+}
+
+std::pair<MsgPack::object::iterator, bool> MsgPack::object::insert(value_type &&value) {
+    iterator const iter = lower_bound(value.first);
+    if (iter != end() && !(value.first < iter->first)) {
+        return std::make_pair(iter, false);
+    }
+    return std::make_pair(emplace_at(iter, std::move(value)), true);
+}
+
+MsgPack & MsgPack::object::operator[](const MsgPack &key) {
+    iterator const iter = lower_bound(key);
+    if (iter != end() && !(key < iter->first)) {
+        return iter->second;
+    }
+    return emplace_at(iter, key, MsgPack())->second;
+}
+
+MsgPack & MsgPack::object::operator[](MsgPack &&key) {
+    iterator const iter = lower_bound(key);
+    if (iter != end() && !(key < iter->first)) {
+        return iter->second;
+    }
+    return emplace_at(iter, std::move(key), MsgPack())->second;
+}
+
+MsgPack::object::size_type MsgPack::object::erase(const MsgPack &key) {
+    const_iterator const iter = find(key);
+    if (iter == end()) {
+        return 0;
+    }
+    erase(iter);
+    return 1;
+}
+
+MsgPack::object::iterator MsgPack::object::erase(const_iterator pos) {
+    std::ptrdiff_t const index = pos - cbegin();
+    free_slot(m_index[index]);
+    m_index.erase(m_index.begin() + index);
+    return begin() + index;
+}
+
+bool MsgPack::object::operator==(const object &rhs) const {
+    return size() == rhs.size() && std::equal(begin(), end(), rhs.begin());
+}
+
+bool MsgPack::object::operator<(const object &rhs) const {
+    return std::lexicographical_compare(begin(), end(), rhs.begin(), rhs.end());
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Comparison
+ */
+
+namespace {
+/* Numbers of any width compare by value. Integers of the same signedness are
+ * compared exactly, mixed signedness goes through the uint64/int64 helpers and
+ * anything involving a float is compared as double.
+ */
+inline bool is_signed_int(MsgPack::Type type) {
+    return type == MsgPack::INT8 || type == MsgPack::INT16 || type == MsgPack::INT32 || type == MsgPack::INT64;
+}
+
+inline bool is_unsigned_int(MsgPack::Type type) {
+    return type == MsgPack::UINT8 || type == MsgPack::UINT16 || type == MsgPack::UINT32 || type == MsgPack::UINT64;
+}
+
+bool number_equals(const MsgPack& lhs, const MsgPack& rhs) {
+    MsgPack::Type const lt = lhs.type();
+    MsgPack::Type const rt = rhs.type();
+    if (is_signed_int(lt) && is_signed_int(rt)) {
+        return lhs.int64_value() == rhs.int64_value();
+    } else if (is_unsigned_int(lt) && is_unsigned_int(rt)) {
+        return lhs.uint64_value() == rhs.uint64_value();
+    } else if (is_signed_int(lt) && is_unsigned_int(rt)) {
+        return equal_uint64_int64(rhs.uint64_value(), lhs.int64_value());
+    } else if (is_unsigned_int(lt) && is_signed_int(rt)) {
+        return equal_uint64_int64(lhs.uint64_value(), rhs.int64_value());
+    }
+    return lhs.float64_value() == rhs.float64_value();
+}
+
+bool number_less(const MsgPack& lhs, const MsgPack& rhs) {
+    MsgPack::Type const lt = lhs.type();
+    MsgPack::Type const rt = rhs.type();
+    if (is_signed_int(lt) && is_signed_int(rt)) {
+        return lhs.int64_value() < rhs.int64_value();
+    } else if (is_unsigned_int(lt) && is_unsigned_int(rt)) {
+        return lhs.uint64_value() < rhs.uint64_value();
+    } else if (is_signed_int(lt) && is_unsigned_int(rt)) {
+        return less_int64_uint64(lhs.int64_value(), rhs.uint64_value());
+    } else if (is_unsigned_int(lt) && is_signed_int(rt)) {
+        return less_uint64_int64(lhs.uint64_value(), rhs.int64_value());
+    }
+    return lhs.float64_value() < rhs.float64_value();
+}
+}
+
+bool MsgPack::operator== (const MsgPack &other) const {
+    if (is_number() && other.is_number()) {
+        return number_equals(*this, other);
+    } else if (m_type != other.m_type) {
+        return false;
+    } else if (m_type == NUL) {
+        return true;
+    } else if (m_type == BOOL) {
+        return m_bool == other.m_bool;
+    } else if (m_type == STRING || m_type == BINARY) {
+        // Owned and borrowed payloads compare alike.
+        return compare_bytes(m_ptr->payload_data(), m_ptr->payload_size(),
+                             other.m_ptr->payload_data(), other.m_ptr->payload_size()) == 0;
+    }
+    return m_ptr->equals(other.m_ptr);
+}
+
+bool MsgPack::operator< (const MsgPack &other) const {
+    if (is_number() && other.is_number()) {
+        return number_less(*this, other);
+    } else if (m_type != other.m_type) {
+        return m_type < other.m_type;
+    } else if (m_type == NUL) {
+        return false;
+    } else if (m_type == BOOL) {
+        return m_bool < other.m_bool;
+    } else if (m_type == STRING || m_type == BINARY) {
+        return compare_bytes(m_ptr->payload_data(), m_ptr->payload_size(),
+                             other.m_ptr->payload_data(), other.m_ptr->payload_size()) < 0;
+    }
+    return m_ptr->less(other.m_ptr);
+}
+
+namespace {
+/* BufferInput
+ *
+ * Parser input over a contiguous memory range. Reads are bounds checked and
+ * never copy more than the requested bytes.
+ */
+class BufferInput {
+public:
+    BufferInput(const uint8_t* begin, const uint8_t* end)
+        : m_pos(begin), m_end(end), m_eof(false), m_fail(false) {}
+
+    uint8_t get() {
+        if (m_pos == m_end) {
+            set_eof();
+            return 0;
+        }
+        return *m_pos++;
+    }
+
+    // Return a pointer to the next n bytes and advance past them, or
+    // nullptr if fewer than n bytes remain.
+    const uint8_t* take(size_t n) {
+        if (static_cast<size_t>(m_end - m_pos) < n) {
+            m_pos = m_end;
+            set_eof();
+            return nullptr;
+        }
+        const uint8_t* const ret = m_pos;
+        m_pos += n;
+        return ret;
+    }
+
+    bool read(uint8_t* dst, size_t n) {
+        const uint8_t* const src = take(n);
+        if (src == nullptr) {
+            return false;
+        }
+        std::copy(src, src + n, dst);
+        return true;
+    }
+
+    bool read(std::string& dst, size_t n) {
+        const uint8_t* const src = take(n);
+        if (src == nullptr) {
+            return false;
+        }
+        dst.assign(reinterpret_cast<const char*>(src), n);
+        return true;
+    }
+
+    bool read(MsgPack::binary& dst, size_t n) {
+        const uint8_t* const src = take(n);
+        if (src == nullptr) {
+            return false;
+        }
+        dst.assign(src, src + n);
+        return true;
+    }
+
+    const uint8_t* pos() const { return m_pos; }
+    size_t remaining() const { return static_cast<size_t>(m_end - m_pos); }
+    bool eof() const { return m_eof; }
+    bool failed() const { return m_fail; }
+    void set_fail() { m_fail = true; }
+
+private:
+    void set_eof() {
+        m_eof = true;
+        m_fail = true;
+    }
+
+    const uint8_t* m_pos;
+    const uint8_t* const m_end;
+    bool m_eof;
+    bool m_fail;
+};
+
+/* ChunkInput
+ *
+ * BufferInput over the bytes an incremental parser has received. When a
+ * payload runs past their end, it records how far the token would reach, so
+ * that the parser can check the token against its limits before keeping any
+ * of it.
+ */
+class ChunkInput : public BufferInput {
+public:
+    ChunkInput(const uint8_t* begin, const uint8_t* end) : BufferInput(begin, end), m_wanted_end(nullptr) {}
+
+    const uint8_t* take(size_t n) {
+        const uint8_t* const begin = pos();
+        const uint8_t* const ret = BufferInput::take(n);
+        if (ret == nullptr) {
+            m_wanted_end = begin + n;
+        }
+        return ret;
+    }
+
+    // Where the token the input ran out in would end, or nullptr if the
+    // input ran out in its header.
+    const uint8_t* wanted_end() const { return m_wanted_end; }
+
+private:
+    const uint8_t* m_wanted_end;
+};
+
+const size_t stream_read_chunk = 64 * 1024;
+
+/* StreamInput
+ *
+ * Parser input over a std::istream. Failures are reported through the
+ * stream state.
+ */
+class StreamInput {
+public:
+    explicit StreamInput(std::istream& is)
+        : m_is(is), m_payload_limit(std::numeric_limits<uint32_t>::max()),
+          m_bytes_left(std::numeric_limits<size_t>::max()), m_exceeded(false) {}
+
+    // Read at most bytes_left bytes, and no payload of more than
+    // payload_limit bytes. Both are checked before reading.
+    void set_limits(uint32_t payload_limit, size_t bytes_left) {
+        m_payload_limit = payload_limit;
+        m_bytes_left = bytes_left;
+    }
+
+    uint8_t get() {
+        if (!spend(1)) {
+            return 0;
+        }
+        return static_cast<uint8_t>(m_is.get());
+    }
+
+    bool read(uint8_t* dst, size_t n) {
+        if (!spend(n)) {
+            return false;
+        }
+        m_is.read(reinterpret_cast<char*>(dst), n);
+        return !failed();
+    }
+
+    bool read(std::string& dst, size_t n) {
+        return read_growing(dst, n);
+    }
+
+    bool read(MsgPack::binary& dst, size_t n) {
+        return read_growing(dst, n);
+    }
+
+    // Read the next n bytes into a scratch buffer owned by this input. The
+    // returned pointer is valid until the next call to take().
+    const uint8_t* take(size_t n) {
+        if (!read_growing(m_scratch, n)) {
+            return nullptr;
+        }
+        return m_scratch.data();
+    }
+
+    bool eof() const { return m_is.eof(); }
+    bool failed() const { return m_is.fail() || m_is.eof(); }
+    void set_fail() { m_is.setstate(std::ios::failbit); }
+    // Return true if a read was refused for going over a limit.
+    bool exceeded() const { return m_exceeded; }
+
+private:
+    bool spend(size_t n) {
+        if (m_bytes_left < n) {
+            m_exceeded = true;
+            set_fail();
+            return false;
+        }
+        m_bytes_left -= n;
+        return true;
+    }
+
+    // Read n bytes into dst, growing it a chunk at a time as the bytes
+    // arrive, so a declared length the stream does not back costs at most
+    // one chunk more than the bytes actually read.
+    template< typename Container >
+    bool read_growing(Container& dst, size_t n) {
+        dst.clear();
+        if (m_payload_limit < n) {
+            m_exceeded = true;
+            set_fail();
+            return false;
+        }
+        if (!spend(n)) {
+            return false;
+        }
+        while (dst.size() < n) {
+            size_t const size = dst.size();
+            size_t const chunk = std::min(n - size, stream_read_chunk);
+            dst.resize(size + chunk);
+            m_is.read(reinterpret_cast<char*>(&dst[0]) + size, static_cast<std::streamsize>(chunk));
+            if (failed()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::istream& m_is;
+    MsgPack::binary m_scratch;
+    uint32_t m_payload_limit;
+    size_t m_bytes_left;
+    bool m_exceeded;
+};
+
+inline void set_value(MsgPackToken& token, float value)    { token.type = MsgPack::FLOAT32; token.float32_value = value; }
+inline void set_value(MsgPackToken& token, double value)   { token.type = MsgPack::FLOAT64; token.float64_value = value; }
+inline void set_value(MsgPackToken& token, int8_t value)   { token.type = MsgPack::INT8;    token.int_value = value; }
+inline void set_value(MsgPackToken& token, int16_t value)  { token.type = MsgPack::INT16;   token.int_value = value; }
+inline void set_value(MsgPackToken& token, int32_t value)  { token.type = MsgPack::INT32;   token.int_value = value; }
+inline void set_value(MsgPackToken& token, int64_t value)  { token.type = MsgPack::INT64;   token.int_value = value; }
+inline void set_value(MsgPackToken& token, uint8_t value)  { token.type = MsgPack::UINT8;   token.uint_value = value; }
+inline void set_value(MsgPackToken& token, uint16_t value) { token.type = MsgPack::UINT16;  token.uint_value = value; }
+inline void set_value(MsgPackToken& token, uint32_t value) { token.type = MsgPack::UINT32;  token.uint_value = value; }
+inline void set_value(MsgPackToken& token, uint64_t value) { token.type = MsgPack::UINT64;  token.uint_value = value; }
+
+/* Arena
+ *
+ * Bump allocator for the values of one parsed document. Nothing is freed
+ * individually; all blocks are released together once the last reference to
+ * the arena is released. The parse holds one reference and every value
+ * allocated from the arena holds another.
+ */
+const size_t arena_min_block_size = 4096;
+const size_t arena_max_block_size = 1 << 20;
+
+class Arena {
+public:
+    explicit Arena(size_t block_size)
+        : m_block_size(std::min(std::max(block_size, arena_min_block_size), arena_max_block_size)),
+          m_pos(0), m_end(0) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align) {
+        uintptr_t pos = (m_pos + align - 1) & ~static_cast<uintptr_t>(align - 1);
+        if (m_end < pos || m_end - pos < size) {
+            add_block(size + align);
+            pos = (m_pos + align - 1) & ~static_cast<uintptr_t>(align - 1);
+        }
+        m_pos = pos + size;
+        return reinterpret_cast<void*>(pos);
+    }
+
+    void set_local() { m_refs.set_local(); }
+    void retain() { m_refs.retain(); }
+    void release() {
+        if (m_refs.release()) {
+            delete this;
+        }
+    }
+
+private:
+    void add_block(size_t min_size) {
+        size_t const size = std::max(min_size, m_block_size);
+        m_blocks.emplace_back(new uint8_t[size]);
+        m_pos = reinterpret_cast<uintptr_t>(m_blocks.back().get());
+        m_end = m_pos + size;
+        m_block_size = std::min(m_block_size * 2, arena_max_block_size);
+    }
+
+    std::vector<std::unique_ptr<uint8_t[]>> m_blocks;
+    size_t m_block_size;
+    uintptr_t m_pos;
+    uintptr_t m_end;
+    RefCount m_refs;
+};
+
+// A value placed in an arena is preceded by a pointer to that arena.
+inline Arena*& arena_of(const MsgPackValue* value) {
+    return reinterpret_cast<Arena**>(const_cast<MsgPackValue*>(value))[-1];
+}
+
+}
+
+void MsgPackValue::destroy() const {
+    if (m_in_arena) {
+        Arena* const arena = arena_of(this);
+        this->~MsgPackValue();
+        arena->release();
+    } else {
+        delete this;
+    }
+}
+
+namespace {
+
+/* OpenStack
+ *
+ * Stack of the arrays and objects open at one point of a walk over encoded
+ * input. The first levels are held inline, so that walking a shallow value
+ * allocates nothing; deeper levels go to the heap, as deep as the depth limit
+ * of the walk allows.
+ */
+template< typename T >
+class OpenStack {
+public:
+    OpenStack() : m_size(0) {}
+
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+    T& back() { return (m_size <= inline_levels) ? m_inline[m_size - 1] : m_heap.back(); }
+
+    void push(const T& value) {
+        if (m_size < inline_levels) {
+            m_inline[m_size] = value;
+        } else {
+            m_heap.push_back(value);
+        }
+        ++m_size;
+    }
+
+    void pop() {
+        if (inline_levels < m_size) {
+            m_heap.pop_back();
+        }
+        --m_size;
+    }
+
+private:
+    enum { inline_levels = 32 };
+
+    T m_inline[inline_levels];
+    std::vector<T> m_heap;
+    size_t m_size;
+};
+
+/* HeapNodes, ArenaNodes
+ *
+ * Allocate the values built by the parser, either individually on the heap
+ * or from the arena of the document being parsed. With borrow set, strings
+ * and binaries are built as views into the input held by owner. With local
+ * set, their reference counts use plain arithmetic. Extensions with a codec
+ * in extensions are built as native values.
+ */
+// The limit on the length of token: on its elements for an array or object,
+// on its payload for a string, binary or extension.
+inline uint32_t length_limit(const MsgPackToken& token, uint32_t element_limit, uint32_t payload_limit) {
+    switch (token.type) {
+    case MsgPack::ARRAY:
+    case MsgPack::OBJECT:
+        return element_limit;
+    case MsgPack::STRING:
+    case MsgPack::BINARY:
+    case MsgPack::EXTENSION:
+        return payload_limit;
+    default:
+        return std::numeric_limits<uint32_t>::max();
+    }
+}
+
+struct NodesBase {
+    NodesBase()
+        : borrow(false), local(false), depth_limit(max_depth),
+          element_limit(std::numeric_limits<uint32_t>::max()),
+          payload_limit(std::numeric_limits<uint32_t>::max()),
+          nodes_left(std::numeric_limits<size_t>::max()), exceeded(false), extensions(nullptr) {}
+
+    void set_limits(const MsgPack::ParseOptions& options) {
+        depth_limit = options.max_depth;
+        element_limit = options.max_elements;
+        payload_limit = options.max_payload;
+        nodes_left = options.max_nodes;
+    }
+
+    // Count the value token starts against the limits, before anything is
+    // allocated for it. Return false if it exceeds one.
+    bool admit(const MsgPackToken& token) {
+        if (nodes_left == 0 || length_limit(token, element_limit, payload_limit) < token.length) {
+            exceeded = true;
+            return false;
+        }
+        --nodes_left;
+        return true;
+    }
+
+    bool borrow;
+    bool local;
+    std::shared_ptr<const void> owner;
+    int depth_limit;
+    uint32_t element_limit;
+    uint32_t payload_limit;
+    size_t nodes_left;
+    bool exceeded;
+    const MsgPackExtensionRegistry* extensions;
+};
+
+struct HeapNodes : NodesBase {
+    template< typename T, typename... Args >
+    MsgPack make(Args&&... args) {
+        T* const value = new T(std::forward<Args>(args)...);
+        if (local) {
+            value->set_local();
+        }
+        return MsgPackValue::handle(value);
+    }
+};
+
+struct ArenaNodes : NodesBase {
+    ArenaNodes(size_t input_size, bool local_refs) : arena(new Arena(input_size * 2)) {
+        local = local_refs;
+        if (local) {
+            arena->set_local();
+        }
+    }
+    ArenaNodes(const ArenaNodes&) = delete;
+    ArenaNodes& operator=(const ArenaNodes&) = delete;
+    ~ArenaNodes() { arena->release(); }
+
+    template< typename T, typename... Args >
+    MsgPack make(Args&&... args) {
+        size_t const header = std::max(sizeof(Arena*), alignof(T));
+        uint8_t* const block = static_cast<uint8_t*>(
+            arena->allocate(header + sizeof(T), std::max(alignof(Arena*), alignof(T))));
+        T* const value = new (block + header) T(std::forward<Args>(args)...);
+        arena_of(value) = arena;
+        arena->retain();
+        value->set_in_arena();
+        if (local) {
+            value->set_local();
+        }
+        return MsgPackValue::handle(value);
+    }
+
+    Arena* const arena;
+};
+
+/* MsgPackParser
+ *
+ * Object that tracks all state of an in-progress parse.
+ */
+namespace MsgPackParser {
+    template< typename T, typename Input >
+    void read_bytes(Input& in, T& bytes)
+    {
+        static_assert(std::is_fundamental<T>::value,
+            "byte read not guaranteed for non-primitive types");
+        int const n = sizeof(T);
+
+        std::array<uint8_t, sizeof(T)> src;
+        // NB: if the read fails it's prefered to return 0 rather than
+        //      corrupted value, for example in the case of reading data size.
+        if (!in.read(src.data(), n)) {
+            bytes = 0;
+            return;
+        }
+
+        bytes = load_be<T>(src.data());
+    }
+
+    /* fail(msg, err_ret = MsgPack())
+     *
+     * Mark this parse as m_failed.
+     */
+    template< typename Input >
+    MsgPack fail(Input& in) {
+        in.set_fail();
+        return MsgPack();
+    }
+
+    template< typename Input >
+    void parse_payload(Input& in, uint32_t bytes, MsgPackToken& token) {
+        token.length = bytes;
+        token.data = in.take(bytes);
+    }
+
+    template< typename Input >
+    void parse_invalid(Input& in, uint8_t, MsgPackToken&) {
+        in.set_fail();
+    }
+
+    template< typename Input >
+    void parse_nil(Input&, uint8_t, MsgPackToken& token) {
+        token.type = MsgPack::NUL;
+    }
+
+    template< typename Input >
+    void parse_bool(Input&, uint8_t first_byte, MsgPackToken& token) {
+        token.type = MsgPack::BOOL;
+        token.bool_value = first_byte == 0xc3;
+    }
+
+    template< typename T, typename Input >
+    void parse_arith(Input& in, uint8_t, MsgPackToken& token) {
+        T tmp;
+        read_bytes(in, tmp);
+        set_value(token, tmp);
+    }
+
+    template< typename T, typename Input >
+    void parse_string(Input& in, uint8_t, MsgPackToken& token) {
+        T bytes;
+        read_bytes(in, bytes);
+        token.type = MsgPack::STRING;
+        parse_payload(in, static_cast<uint32_t>(bytes), token);
+    }
+
+    template< typename T, typename Input >
+    void parse_array(Input& in, uint8_t, MsgPackToken& token) {
+        T bytes;
+        read_bytes(in, bytes);
+        token.type = MsgPack::ARRAY;
+        token.length = static_cast<uint32_t>(bytes);
+    }
+
+    template< typename T, typename Input >
+    void parse_object(Input& in, uint8_t, MsgPackToken& token) {
+        T bytes;
+        read_bytes(in, bytes);
+        token.type = MsgPack::OBJECT;
+        token.length = static_cast<uint32_t>(bytes);
+    }
+
+    template< typename T, typename Input >
+    void parse_binary(Input& in, uint8_t, MsgPackToken& token) {
+        T bytes;
+        read_bytes(in, bytes);
+        token.type = MsgPack::BINARY;
+        parse_payload(in, static_cast<uint32_t>(bytes), token);
+    }
+
+    template< typename T, typename Input >
+    void parse_extension(Input& in, uint8_t, MsgPackToken& token) {
+        T bytes;
+        read_bytes(in, bytes);
+        read_bytes(in, token.ext_type);
+        token.type = MsgPack::EXTENSION;
+        parse_payload(in, static_cast<uint32_t>(bytes), token);
+    }
+
+    template< typename Input >
+    void parse_pos_fixint(Input&, uint8_t first_byte, MsgPackToken& token) {
+        set_value(token, first_byte);
+    }
+
+    template< typename Input >
+    void parse_fixobject(Input&, uint8_t first_byte, MsgPackToken& token) {
+        token.type = MsgPack::OBJECT;
+        token.length = first_byte & 0x0f;
+    }
+
+    template< typename Input >
+    void parse_fixarray(Input&, uint8_t first_byte, MsgPackToken& token) {
+        token.type = MsgPack::ARRAY;
+        token.length = first_byte & 0x0f;
+    }
+
+    template< typename Input >
+    void parse_fixstring(Input& in, uint8_t first_byte, MsgPackToken& token) {
+        token.type = MsgPack::STRING;
+        parse_payload(in, first_byte & 0x1f, token);
+    }
+
+    template< typename Input >
+    void parse_neg_fixint(Input&, uint8_t first_byte, MsgPackToken& token) {
+        set_value(token, static_cast<int8_t>(first_byte));
+    }
+
+    template< typename Input >
+    void parse_fixext(Input& in, uint8_t first_byte, MsgPackToken& token) {
+        read_bytes(in, token.ext_type);
+        token.type = MsgPack::EXTENSION;
+        parse_payload(in, 1 << (first_byte - 0xd4u), token);
+    }
+
+    /* parse_token()
+     *
+     * Read the next item from the input. Arrays and objects only yield their
+     * header; their elements follow as separate tokens.
+     */
+    template< typename Input >
+    bool parse_token(Input& in, MsgPackToken& token) {
+        using parser_type = void(*)(Input&, uint8_t, MsgPackToken&);
+        static const std::array< parser_type, 256 > parsers = [](){
+            using parser_template_element_type = std::tuple<uint8_t, parser_type>;
+            std::array< parser_template_element_type, 36 > const parser_template{{
+                parser_template_element_type{ 0x7fu, &MsgPackParser::parse_pos_fixint<Input>},
+                parser_template_element_type{ 0x8fu, &MsgPackParser::parse_fixobject<Input>},
+                parser_template_element_type{ 0x9fu, &MsgPackParser::parse_fixarray<Input>},
+                parser_template_element_type{ 0xbfu, &MsgPackParser::parse_fixstring<Input>},
+                parser_template_element_type{ 0xc0u, &MsgPackParser::parse_nil<Input>},
+                parser_template_element_type{ 0xc1u, &MsgPackParser::parse_invalid<Input>},
+                parser_template_element_type{ 0xc3u, &MsgPackParser::parse_bool<Input>},
+                parser_template_element_type{ 0xc4u, &MsgPackParser::parse_binary<uint8_t, Input>},
+                parser_template_element_type{ 0xc5u, &MsgPackParser::parse_binary<uint16_t, Input>},
+                parser_template_element_type{ 0xc6u, &MsgPackParser::parse_binary<uint32_t, Input>},
+                parser_template_element_type{ 0xc7u, &MsgPackParser::parse_extension<uint8_t, Input>},
+                parser_template_element_type{ 0xc8u, &MsgPackParser::parse_extension<uint16_t, Input>},
+                parser_template_element_type{ 0xc9u, &MsgPackParser::parse_extension<uint32_t, Input>},
+                parser_template_element_type{ 0xcau, &MsgPackParser::parse_arith<float, Input>},
+                parser_template_element_type{ 0xcbu, &MsgPackParser::parse_arith<double, Input>},
+                parser_template_element_type{ 0xccu, &MsgPackParser::parse_arith<uint8_t, Input>},
+                parser_template_element_type{ 0xcdu, &MsgPackParser::parse_arith<uint16_t, Input>},
+                parser_template_element_type{ 0xceu, &MsgPackParser::parse_arith<uint32_t, Input>},
+                parser_template_element_type{ 0xcfu, &MsgPackParser::parse_arith<uint64_t, Input>},
+                parser_template_element_type{ 0xd0u, &MsgPackParser::parse_arith<int8_t, Input>},
+                parser_template_element_type{ 0xd1u, &MsgPackParser::parse_arith<int16_t, Input>},
+                parser_template_element_type{ 0xd2u, &MsgPackParser::parse_arith<int32_t, Input>},
+                parser_template_element_type{ 0xd3u, &MsgPackParser::parse_arith<int64_t, Input>},
+                parser_template_element_type{ 0xd8u, &MsgPackParser::parse_fixext<Input>},
+                parser_template_element_type{ 0xd9u, &MsgPackParser::parse_string<uint8_t, Input>},
+                parser_template_element_type{ 0xdau, &MsgPackParser::parse_string<uint16_t, Input>},
+                parser_template_element_type{ 0xdbu, &MsgPackParser::parse_string<uint32_t, Input>},
+                parser_template_element_type{ 0xdcu, &MsgPackParser::parse_array<uint16_t, Input>},
+                parser_template_element_type{ 0xddu, &MsgPackParser::parse_array<uint32_t, Input>},
+                parser_template_element_type{ 0xdeu, &MsgPackParser::parse_object<uint16_t, Input>},
+                parser_template_element_type{ 0xdfu, &MsgPackParser::parse_object<uint32_t, Input>},
+                parser_template_element_type{ 0xffu, &MsgPackParser::parse_neg_fixint<Input>}
+            }};
+
+            std::array< parser_type, 256 > parsers;
+            int i = 0;
+            std::for_each(std::begin(parser_template),
+                         std::end(parser_template),
+                         [&parsers,&i]( parser_template_element_type const& element ) {
+                            int upto = std::get<0>( element );
+                            auto parser = std::get<1>( element );
+                            while(i <= upto)
+                            {
+                                parsers[i] = parser;
+                                ++i;
+                            }
+                         });
+            return parsers;
+        }();
+
+        uint8_t const first_byte = in.get();
+        // check for fail/eof after get() as eof only set after read past the end
+        if (in.failed()) {
+            return false;
+        }
+
+        (*parsers[first_byte])(in, first_byte, token);
+        return !in.failed();
+    }
+
+    inline MsgPack::binary parse_binary_impl(const MsgPackToken& token) {
+        return MsgPack::binary(token.data, token.data + token.length);
+    }
+
+    /* parse_value()
+     *
+     * Build the MsgPack for a token that is not an array or object header.
+     */
+    template< typename Nodes >
+    MsgPack parse_value(const MsgPackToken& token, Nodes& nodes) {
+        switch (token.type) {
+            case MsgPack::BOOL:    return MsgPack(token.bool_value);
+            case MsgPack::FLOAT32: return MsgPack(token.float32_value);
+            case MsgPack::FLOAT64: return MsgPack(token.float64_value);
+            case MsgPack::INT8:    return MsgPack(static_cast<int8_t>(token.int_value));
+            case MsgPack::INT16:   return MsgPack(static_cast<int16_t>(token.int_value));
+            case MsgPack::INT32:   return MsgPack(static_cast<int32_t>(token.int_value));
+            case MsgPack::INT64:   return MsgPack(token.int_value);
+            case MsgPack::UINT8:   return MsgPack(static_cast<uint8_t>(token.uint_value));
+            case MsgPack::UINT16:  return MsgPack(static_cast<uint16_t>(token.uint_value));
+            case MsgPack::UINT32:  return MsgPack(static_cast<uint32_t>(token.uint_value));
+            case MsgPack::UINT64:  return MsgPack(token.uint_value);
+            case MsgPack::STRING:
+                if (nodes.borrow) {
+                    return nodes.template make<MsgPackBorrowedString>(token.data, token.length, nodes.owner);
+                }
+                return nodes.template make<MsgPackString>(std::string(token.string_data(), token.length));
+            case MsgPack::BINARY:
+                if (nodes.borrow) {
+                    return nodes.template make<MsgPackBorrowedBinary>(token.data, token.length, nodes.owner);
+                }
+                return nodes.template make<MsgPackBinary>(parse_binary_impl(token));
+            case MsgPack::EXTENSION:
+                if (nodes.extensions != nullptr) {
+                    const MsgPackExtensionCodec* const codec = nodes.extensions->find(token.ext_type);
+                    alignas(MsgPackExtensionCodec::max_value_align) unsigned char value[MsgPackExtensionCodec::max_value_size];
+                    if (codec != nullptr && codec->decode(token.data, token.length, value)) {
+                        return nodes.template make<MsgPackNativeExtension>(*codec, static_cast<const void*>(value));
+                    }
+                }
+                return nodes.template make<MsgPackExtension>(std::make_tuple(token.ext_type, parse_binary_impl(token)));
+            default:
+                return MsgPack();
+        }
+    }
+
+    /* ParseFrame
+     *
+     * An array or object being parsed: its elements, or its keys and values
+     * alternately, are the values from start on the parser's value stack.
+     */
+    struct ParseFrame {
+        size_t start;
+        uint64_t remaining;
+        bool is_object;
+    };
+
+    /* close_frame()
+     *
+     * Build the array or object of a completed frame, taking its elements off
+     * the value stack.
+     */
+    template< typename Nodes >
+    MsgPack close_frame(const ParseFrame& frame, std::vector<MsgPack>& values, Nodes& nodes) {
+        typedef std::vector<MsgPack>::iterator iterator;
+        iterator const first = values.begin() + static_cast<std::ptrdiff_t>(frame.start);
+        MsgPack ret;
+        if (frame.is_object) {
+            std::vector<std::pair<MsgPack, MsgPack>> pairs;
+            pairs.reserve((values.size() - frame.start) / 2);
+            for (iterator it = first; it != values.end(); it += 2) {
+                pairs.emplace_back(std::move(*it), std::move(*(it + 1)));
+            }
+            ret = nodes.template make<MsgPackObject>(MsgPack::object(std::move(pairs)));
+        } else {
+            ret = nodes.template make<MsgPackArray>(MsgPack::array(std::make_move_iterator(first),
+                                                                   std::make_move_iterator(values.end())));
+        }
+        values.erase(first, values.end());
+        return ret;
+    }
+
+    /* parse_msgpack(token)
+     *
+     * Parse the MsgPack value at the given depth whose first token has
+     * already been read. Open arrays and objects are kept on an explicit
+     * stack rather than the native one, and their elements on one value stack
+     * shared by all levels, so nesting costs no recursion and each container
+     * is allocated once, at its final size, when it is complete.
+     */
+    template< typename Input, typename Nodes >
+    MsgPack parse_msgpack(Input& in, Nodes& nodes, const MsgPackToken& first_token, int depth) {
+        std::vector<ParseFrame> frames;
+        std::vector<MsgPack> values;
+        MsgPackToken token = first_token;
+        for (;;) {
+            if (!nodes.admit(token)) {
+                return fail(in);
+            }
+            MsgPack value;
+            if (token.type == MsgPack::ARRAY || token.type == MsgPack::OBJECT) {
+                bool const is_object = token.type == MsgPack::OBJECT;
+                if (0 < token.length) {
+                    if (nodes.depth_limit <= depth + static_cast<int>(frames.size())) {
+                        // "exceeded maximum nesting depth."
+                        nodes.exceeded = true;
+                        return fail(in);
+                    }
+                    uint64_t const count = is_object ? 2 * static_cast<uint64_t>(token.length) : token.length;
+                    frames.push_back(ParseFrame{ values.size(), count, is_object });
+                    if (!parse_token(in, token)) {
+                        return fail(in);
+                    }
+                    continue;
+                }
+                if (is_object) {
+                    value = nodes.template make<MsgPackObject>(MsgPack::object());
+                } else {
+                    value = nodes.template make<MsgPackArray>(MsgPack::array());
+                }
+            } else {
+                value = parse_value(token, nodes);
+            }
+
+            // A value is complete; close every container it completes.
+            for (;;) {
+                if (frames.empty()) {
+                    return value;
+                }
+                values.push_back(std::move(value));
+                if (0 < --frames.back().remaining) {
+                    break;
+                }
+                value = close_frame(frames.back(), values, nodes);
+                frames.pop_back();
+            }
+
+            if (!parse_token(in, token)) {
+                return fail(in);
+            }
+        }
+    }
+
+    /* parse_msgpack()
+     *
+     * Parse a MsgPack value.
+     */
+    template< typename Input, typename Nodes >
+    MsgPack parse_msgpack(Input& in, Nodes& nodes, int depth) {
+        if (nodes.depth_limit < depth) {
+            // "exceeded maximum nesting depth."
+            nodes.exceeded = true;
+            return fail(in);
+        }
+
+        MsgPackToken token;
+        if (!parse_token(in, token)) {
+            return fail(in);
+        }
+        return parse_msgpack(in, nodes, token, depth);
+    }
+
+    /* visit_scalar()
+     *
+     * Report a token that is not an array or object header to visitor.
+     */
+    inline bool visit_scalar(const MsgPackToken& token, MsgPackVisitor& visitor) {
+        switch (token.type) {
+            case MsgPack::NUL:     return visitor.on_nil();
+            case MsgPack::BOOL:    return visitor.on_bool(token.bool_value);
+            case MsgPack::FLOAT32: return visitor.on_float32(token.float32_value);
+            case MsgPack::FLOAT64: return visitor.on_float64(token.float64_value);
+            case MsgPack::INT8:    // fall through
+            case MsgPack::INT16:   // fall through
+            case MsgPack::INT32:   // fall through
+            case MsgPack::INT64:   return visitor.on_int(token.int_value);
+            case MsgPack::UINT8:   // fall through
+            case MsgPack::UINT16:  // fall through
+            case MsgPack::UINT32:  // fall through
+            case MsgPack::UINT64:  return visitor.on_uint(token.uint_value);
+            case MsgPack::STRING:
+                return visitor.on_string(token.string_data(), token.length);
+            case MsgPack::BINARY:
+                return visitor.on_binary(token.data, token.length);
+            case MsgPack::EXTENSION:
+                return visitor.on_extension(token.ext_type, token.data, token.length);
+            default:
+                return false;
+        }
+    }
+
+    /* visit_msgpack()
+     *
+     * Parse a MsgPack value, reporting it to visitor instead of building it.
+     * Returns false if the parse failed or the visitor asked to stop. Like
+     * parse_msgpack(), it keeps open arrays and objects on its own stack.
+     */
+    template< typename Input >
+    bool visit_msgpack(Input& in, MsgPackVisitor& visitor, int depth, int depth_limit) {
+        if (depth_limit < depth) {
+            // "exceeded maximum nesting depth."
+            in.set_fail();
+            return false;
+        }
+
+        // Open arrays and objects as (values still to come, is object).
+        OpenStack<std::pair<uint64_t, bool>> open;
+        do {
+            MsgPackToken token;
+            if (!parse_token(in, token)) {
+                in.set_fail();
+                return false;
+            }
+
+            if (token.type == MsgPack::ARRAY || token.type == MsgPack::OBJECT) {
+                bool const is_object = token.type == MsgPack::OBJECT;
+                if (!(is_object ? visitor.on_map_begin(token.length) : visitor.on_array_begin(token.length))) {
+                    return false;
+                }
+                if (0 < token.length) {
+                    if (static_cast<size_t>(depth_limit - depth) <= open.size()) {
+                        // "exceeded maximum nesting depth."
+                        in.set_fail();
+                        return false;
+                    }
+                    uint64_t const values = is_object ? 2 * static_cast<uint64_t>(token.length) : token.length;
+                    open.push(std::make_pair(values, is_object));
+                    continue;
+                }
+                if (!(is_object ? visitor.on_map_end() : visitor.on_array_end())) {
+                    return false;
+                }
+            } else if (!visit_scalar(token, visitor)) {
+                return false;
+            }
+
+            // A value is complete; close every container it completes.
+            while (!open.empty() && --open.back().first == 0) {
+                bool const is_object = open.back().second;
+                open.pop();
+                if (!(is_object ? visitor.on_map_end() : visitor.on_array_end())) {
+                    return false;
+                }
+            }
+        } while (!open.empty());
+        return true;
+    }
+
+    /* skip_values()
+     *
+     * Step over count values, including every element of arrays and objects
+     * among them, without decoding them.
+     */
+    template< typename Input >
+    bool skip_values(Input& in, uint64_t count) {
+        MsgPackToken token;
+        while (0 < count) {
+            if (!parse_token(in, token)) {
+                in.set_fail();
+                return false;
+            }
+            --count;
+            if (token.type == MsgPack::ARRAY) {
+                count += token.length;
+            } else if (token.type == MsgPack::OBJECT) {
+                count += 2 * static_cast<uint64_t>(token.length);
+            }
+        }
+        return true;
+    }
+
+    // Number of values following a token that belong to it.
+    inline uint64_t element_count(const MsgPackToken& token) {
+        if (token.type == MsgPack::ARRAY) {
+            return token.length;
+        } else if (token.type == MsgPack::OBJECT) {
+            return 2 * static_cast<uint64_t>(token.length);
+        }
+        return 0;
+    }
+
+    /* Projection
+     *
+     * Trie of the key paths given to parse_projected(). Node 0 is the root.
+     * A key matching both a named step and "*" follows both, so the subtrie
+     * under "*" is merged into each named sibling once the paths are in.
+     */
+    struct Projection {
+        struct Node {
+            Node() : leaf(false), any(-1) {}
+
+            bool leaf;
+            int any;
+            std::vector<std::pair<std::string, int>> keys;
+        };
+
+        explicit Projection(const std::vector<MsgPack::key_path>& paths) : nodes(1) {
+            for (const MsgPack::key_path& path : paths) {
+                int node = 0;
+                for (const std::string& step : path) {
+                    node = child(node, step);
+                }
+                nodes[node].leaf = true;
+            }
+            // Nodes merged into are always created after their parent, so
+            // a single pass in index order reaches them too.
+            for (size_t n = 0; n < nodes.size(); ++n) {
+                int const any = nodes[n].any;
+                for (size_t k = 0; 0 <= any && k < nodes[n].keys.size(); ++k) {
+                    merge(nodes[n].keys[k].second, any);
+                }
+            }
+        }
+
+        // Add the paths below node from to those below node into.
+        void merge(int into, int from) {
+            if (nodes[from].leaf) {
+                nodes[into].leaf = true;
+            }
+            if (0 <= nodes[from].any) {
+                int const any = nodes[from].any;
+                merge(child(into, "*"), any);
+            }
+            for (size_t k = 0; k < nodes[from].keys.size(); ++k) {
+                // child() may grow nodes, so copy the key first.
+                std::pair<std::string, int> const key = nodes[from].keys[k];
+                merge(child(into, key.first), key.second);
+            }
+        }
+
+        int child(int node, const std::string& step) {
+            int found = (step == "*") ? nodes[node].any : find(node, step.data(), step.size());
+            if (found < 0) {
+                found = static_cast<int>(nodes.size());
+                nodes.emplace_back();
+                if (step == "*") {
+                    nodes[node].any = found;
+                } else {
+                    nodes[node].keys.emplace_back(step, found);
+                }
+            }
+            return found;
+        }
+
+        int find(int node, const char* key, size_t len) const {
+            for (const std::pair<std::string, int>& k : nodes[node].keys) {
+                if (k.first.size() == len && (len == 0 || std::memcmp(k.first.data(), key, len) == 0)) {
+                    return k.second;
+                }
+            }
+            return -1;
+        }
+
+        std::vector<Node> nodes;
+    };
+
+    /* parse_projected()
+     *
+     * Parse the parts of a value selected by node of projection. Return false
+     * if nothing in the value matches; the value has been skipped then.
+     */
+    template< typename Input, typename Nodes >
+    bool parse_projected(Input& in, Nodes& nodes, const Projection& projection, int node, int depth, MsgPack& out) {
+        if (nodes.depth_limit < depth) {
+            // "exceeded maximum nesting depth."
+            in.set_fail();
+            return false;
+        }
+        if (projection.nodes[node].leaf) {
+            out = parse_msgpack(in, nodes, depth);
+            return !in.failed();
+        }
+
+        MsgPackToken token;
+        if (!parse_token(in, token)) {
+            in.set_fail();
+            return false;
+        }
+
+        const Projection::Node& current = projection.nodes[node];
+        if (token.type == MsgPack::ARRAY && 0 <= current.any) {
+            if (!nodes.admit(token)) {
+                in.set_fail();
+                return false;
+            }
+            MsgPack::array items;
+            // Every element takes at least one byte of input.
+            items.reserve(std::min<size_t>(token.length, in.remaining()));
+            for (uint32_t i = 0; i < token.length; ++i) {
+                MsgPack item;
+                parse_projected(in, nodes, projection, current.any, depth + 1, item);
+                if (in.failed()) {
+                    return false;
+                }
+                items.push_back(std::move(item));
+            }
+            out = MsgPack(std::move(items));
+            return true;
+        }
+
+        if (token.type == MsgPack::OBJECT && (0 <= current.any || !current.keys.empty())) {
+            if (!nodes.admit(token)) {
+                in.set_fail();
+                return false;
+            }
+            std::vector<std::pair<MsgPack, MsgPack>> items;
+            for (uint32_t i = 0; i < token.length; ++i) {
+                MsgPackToken key;
+                if (!parse_token(in, key)) {
+                    in.set_fail();
+                    return false;
+                }
+                int const next = (key.type == MsgPack::STRING) ? projection.find(node, key.string_data(), key.length) : -1;
+                if (next < 0 && current.any < 0) {
+                    // Skip the rest of the key and the whole value.
+                    if (!skip_values(in, element_count(key) + 1)) {
+                        return false;
+                    }
+                    continue;
+                }
+                MsgPack key_value = parse_msgpack(in, nodes, key, depth + 1);
+                MsgPack value;
+                if (parse_projected(in, nodes, projection, (0 <= next) ? next : current.any, depth + 1, value)) {
+                    items.emplace_back(std::move(key_value), std::move(value));
+                }
+                if (in.failed()) {
+                    return false;
+                }
+            }
+            out = MsgPack(MsgPack::object(std::move(items)));
+            return true;
+        }
+
+        skip_values(in, element_count(token));
+        return false;
+    }
+
+    template< typename Input >
+    void set_error(const Input& in, std::string& err) {
+        if (in.eof()) {
+            err = "end of buffer.";
+        } else if (in.failed()) {
+            err = "format error.";
+        }
+    }
+};
+
+}//namespace {
+
+std::istream& operator>>(std::istream& is, MsgPack& msgpack) {
+    StreamInput in(is);
+    HeapNodes nodes;
+    msgpack = MsgPackParser::parse_msgpack(in, nodes, 0);
+    return is;
+}
+
+MsgPack MsgPack::parse(std::istream& is) {
+    StreamInput in(is);
+    HeapNodes nodes;
+    return MsgPackParser::parse_msgpack(in, nodes, 0);
+}
+
+MsgPack MsgPack::parse(std::istream& is, std::string &err) {
+    StreamInput in(is);
+    HeapNodes nodes;
+    MsgPack ret = MsgPackParser::parse_msgpack(in, nodes, 0);
+    MsgPackParser::set_error(in, err);
+    return ret;
+}
+
+MsgPack MsgPack::parse(std::istream& is, std::string &err, const ParseOptions & options) {
+    StreamInput in(is);
+    in.set_limits(options.max_payload, options.max_bytes);
+    HeapNodes nodes;
+    nodes.local = options.single_thread;
+    nodes.set_limits(options);
+    nodes.extensions = options.extensions;
+    MsgPack ret = MsgPackParser::parse_msgpack(in, nodes, 0);
+    if (nodes.exceeded || in.exceeded()) {
+        err = "exceeded parse limit.";
+        return MsgPack();
+    }
+    MsgPackParser::set_error(in, err);
+    return ret;
+}
+
+MsgPack MsgPack::parse(const std::string &in, string &err) {
+    return parse(in.data(), in.size(), err);
+}
+
+MsgPack MsgPack::parse(const char * in, size_t len, std::string & err) {
+    return parse(reinterpret_cast<const uint8_t*>(in), len, err);
+}
+
+MsgPack MsgPack::parse(const uint8_t * in, size_t len, std::string & err) {
+    return parse(in, len, err, ParseOptions());
+}
+
+MsgPack MsgPack::parse(const char * in, size_t len, std::string & err, const ParseOptions & options) {
+    return parse(reinterpret_cast<const uint8_t*>(in), len, err, options);
+}
+
+namespace {
+/* parse_buffer()
+ *
+ * Parse from a memory buffer with options, calling parse(input, nodes) with
+ * nodes set up from them. Shared by parse() and parse_projected().
+ */
+template< typename Parse >
+MsgPack parse_buffer(const uint8_t * in, size_t len, std::string & err,
+                     const MsgPack::ParseOptions & options, const Parse & parse) {
+    if (in == nullptr) {
+        err = "null input";
+        return nullptr;
+    }
+
+    // Parse no further than max_bytes; running out of input there means the
+    // document is longer.
+    size_t const size = std::min(len, options.max_bytes);
+    BufferInput input(in, in + size);
+    MsgPack ret;
+    bool exceeded;
+    if (options.use_arena) {
+        ArenaNodes nodes(size, options.single_thread);
+        nodes.borrow = options.borrow_payloads;
+        nodes.owner = options.input_owner;
+        nodes.set_limits(options);
+        nodes.extensions = options.extensions;
+        ret = parse(input, nodes);
+        exceeded = nodes.exceeded;
+    } else {
+        HeapNodes nodes;
+        nodes.local = options.single_thread;
+        nodes.borrow = options.borrow_payloads;
+        nodes.owner = options.input_owner;
+        nodes.set_limits(options);
+        nodes.extensions = options.extensions;
+        ret = parse(input, nodes);
+        exceeded = nodes.exceeded;
+    }
+    if (exceeded || (input.eof() && size < len)) {
+        err = "exceeded parse limit.";
+        return MsgPack();
+    }
+    MsgPackParser::set_error(input, err);
+    return input.failed() ? MsgPack() : ret;
+}
+
+struct ParseWhole {
+    template< typename Nodes >
+    MsgPack operator()(BufferInput& input, Nodes& nodes) const {
+        return MsgPackParser::parse_msgpack(input, nodes, 0);
+    }
+};
+
+struct ParseProjected {
+    const MsgPackParser::Projection& projection;
+
+    template< typename Nodes >
+    MsgPack operator()(BufferInput& input, Nodes& nodes) const {
+        MsgPack ret;
+        MsgPackParser::parse_projected(input, nodes, projection, 0, 0, ret);
+        return ret;
+    }
+};
+}
+
+MsgPack MsgPack::parse(const uint8_t * in, size_t len, std::string & err, const ParseOptions & options) {
+    return parse_buffer(in, len, err, options, ParseWhole());
+}
+
+MsgPack MsgPack::parse_projected(const char * in, size_t len, const std::vector<key_path> & paths, std::string & err) {
+    return parse_projected(reinterpret_cast<const uint8_t*>(in), len, paths, err, ParseOptions());
+}
+
+MsgPack MsgPack::parse_projected(const uint8_t * in, size_t len, const std::vector<key_path> & paths, std::string & err) {
+    return parse_projected(in, len, paths, err, ParseOptions());
+}
+
+MsgPack MsgPack::parse_projected(const char * in, size_t len, const std::vector<key_path> & paths, std::string & err,
+                                 const ParseOptions & options) {
+    return parse_projected(reinterpret_cast<const uint8_t*>(in), len, paths, err, options);
+}
+
+MsgPack MsgPack::parse_projected(const uint8_t * in, size_t len, const std::vector<key_path> & paths, std::string & err,
+                                 const ParseOptions & options) {
+    MsgPackParser::Projection const projection(paths);
+    return parse_buffer(in, len, err, options, ParseProjected{ projection });
+}
+
+bool MsgPack::parse(const char * in, size_t len, MsgPackVisitor & visitor, std::string & err) {
+    return parse(reinterpret_cast<const uint8_t*>(in), len, visitor, err, ParseOptions());
+}
+
+bool MsgPack::parse(const uint8_t * in, size_t len, MsgPackVisitor & visitor, std::string & err) {
+    return parse(in, len, visitor, err, ParseOptions());
+}
+
+bool MsgPack::parse(const char * in, size_t len, MsgPackVisitor & visitor, std::string & err,
+                    const ParseOptions & options) {
+    return parse(reinterpret_cast<const uint8_t*>(in), len, visitor, err, options);
+}
+
+bool MsgPack::parse(const uint8_t * in, size_t len, MsgPackVisitor & visitor, std::string & err,
+                    const ParseOptions & options) {
+    if (in == nullptr) {
+        err = "null input";
+        return false;
+    }
+
+    BufferInput input(in, in + len);
+    if (!MsgPackParser::visit_msgpack(input, visitor, 0, options.max_depth)) {
+        if (input.failed()) {
+            MsgPackParser::set_error(input, err);
+        } else {
+            err = "stopped by visitor.";
+        }
+        return false;
+    }
+    return true;
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * MsgPackReader
+ */
+
+MsgPackReader::MsgPackReader(const uint8_t * data, size_t size)
+    : m_pos(data), m_end(data + size), m_eof(false), m_fail(data == nullptr) {}
+
+MsgPackReader::MsgPackReader(const char * data, size_t size)
+    : MsgPackReader(reinterpret_cast<const uint8_t*>(data), size) {}
+
+bool MsgPackReader::next(MsgPackToken & token) {
+    if (m_fail) {
+        return false;
+    }
+
+    BufferInput input(m_pos, m_end);
+    bool const ret = MsgPackParser::parse_token(input, token);
+    m_pos = input.pos();
+    m_eof = input.eof();
+    m_fail = input.failed();
+    return ret;
+}
+
+bool MsgPackReader::skip() {
+    // Count the values still to be read instead of recursing, so skipping
+    // needs no stack and works at any depth.
+    MsgPackToken token;
+    uint64_t remaining = 1;
+    while (0 < remaining) {
+        if (!next(token)) {
+            return false;
+        }
+        --remaining;
+        if (token.type == MsgPack::ARRAY) {
+            remaining += token.length;
+        } else if (token.type == MsgPack::OBJECT) {
+            remaining += 2 * static_cast<uint64_t>(token.length);
+        }
+    }
+    return true;
+}
+
+const char * MsgPackReader::error() const {
+    if (m_eof) {
+        return "end of buffer.";
+    } else if (m_fail) {
+        return "format error.";
+    }
+    return nullptr;
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * validate()
+ */
+
+namespace {
+/* fixint_run()
+ *
+ * Return how many of the first n bytes at data are a run of positive or
+ * negative fixints, i.e. one-byte values. Integer arrays are mostly such runs,
+ * so they are checked 16 bytes at a time where SSE2 is available.
+ */
+inline size_t fixint_run(const uint8_t* data, size_t n) {
+    size_t i = 0;
+#ifdef MSGPACK11_SSE2
+    // As signed bytes, fixints are exactly the values above -33
+    // (0x00-0x7f and 0xe0-0xff).
+    __m128i const limit = _mm_set1_epi8(-33);
+    for (; i + 16 <= n; i += 16) {
+        __m128i const bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(bytes, limit)) != 0xffff) {
+            break;
+        }
+    }
+#endif
+    while (i < n && (data[i] <= 0x7f || 0xe0 <= data[i])) {
+        ++i;
+    }
+    return i;
+}
+}
+
+MsgPackValidation validate(const char * data, size_t len) {
+    return validate(reinterpret_cast<const uint8_t*>(data), len, MsgPack::ParseOptions());
+}
+
+MsgPackValidation validate(const uint8_t * data, size_t len) {
+    return validate(data, len, MsgPack::ParseOptions());
+}
+
+MsgPackValidation validate(const char * data, size_t len, const MsgPack::ParseOptions & options) {
+    return validate(reinterpret_cast<const uint8_t*>(data), len, options);
+}
+
+MsgPackValidation validate(const uint8_t * data, size_t len, const MsgPack::ParseOptions & options) {
+    MsgPackValidation ret;
+    ret.status = MsgPackValidation::MALFORMED;
+    ret.size = 0;
+    ret.nodes = 0;
+    ret.max_depth = 0;
+    if (data == nullptr) {
+        return ret;
     }
-public:
-    explicit MsgPackInt64(int64_t value) : NumberValue(value) {}
-};
 
-class MsgPackUint8 final : public NumberValue<MsgPack::UINT8, uint8_t> {
-public:
-    explicit MsgPackUint8(uint8_t value) : NumberValue(value) {}
-};
+    // Values still to come in each open array or object, under the top level
+    // at the bottom; the depth is the number of arrays and objects open.
+    OpenStack<uint64_t> remaining;
+    remaining.push(1);
 
-class MsgPackUint16 final : public NumberValue<MsgPack::UINT16, uint16_t> {
-public:
-    explicit MsgPackUint16(uint16_t value) : NumberValue(value) {}
-};
+    // Read no further than max_bytes, as parse() does.
+    const uint8_t* pos = data;
+    const uint8_t* const end = data + std::min(len, options.max_bytes);
+    while (true) {
+        size_t const depth = remaining.size() - 1;
+        ret.max_depth = std::max(ret.max_depth, depth + 1);
 
-class MsgPackUint32 final : public NumberValue<MsgPack::UINT32, uint32_t> {
-public:
-    explicit MsgPackUint32(uint32_t value) : NumberValue(value) {}
-};
+        // Consume whole runs of fixints without going through parse_token(),
+        // leaving the one over max_nodes to it.
+        size_t const run = fixint_run(pos, static_cast<size_t>(std::min<uint64_t>(
+            std::min<uint64_t>(remaining.back(), end - pos), options.max_nodes - ret.nodes)));
+        pos += run;
+        ret.nodes += run;
+        remaining.back() -= run;
 
-class MsgPackUint64 final : public NumberValue<MsgPack::UINT64, uint64_t> {
-    bool equals(const MsgPackValue * other) const override
-    {
-        switch( other->type() )
-        {
-            case MsgPack::INT64 :
-            {
-                return equal_uint64_int64( uint64_value(), other->int64_value() );
-            } break;
-            case MsgPack::UINT64 :
-            {
-                return uint64_value() == other->uint64_value();
-            } break;
-            default :
-            {
-                return NumberValue<MsgPack::UINT64, uint64_t>::equals( other );
+        if (0 < remaining.back()) {
+            BufferInput in(pos, end);
+            MsgPackToken token;
+            if (!MsgPackParser::parse_token(in, token)) {
+                ret.status = !in.eof() ? MsgPackValidation::MALFORMED :
+                             (end < data + len) ? MsgPackValidation::EXCEEDED : MsgPackValidation::INCOMPLETE;
+                ret.size = static_cast<size_t>(pos - data);
+                return ret;
             }
-        }
-    }
-    bool less(const MsgPackValue * other)   const override
-    {
-        switch( other->type() )
-        {
-            case MsgPack::INT64 :
-            {
-                return less_uint64_int64( uint64_value(), other->uint64_value() );
-            } break;
-            case MsgPack::UINT64 :
-            {
-                return uint64_value() < other->uint64_value();
-            } break;
-            default :
-            {
-                return NumberValue<MsgPack::UINT64, uint64_t>::less( other );
+            if (ret.nodes == options.max_nodes ||
+                length_limit(token, options.max_elements, options.max_payload) < token.length) {
+                ret.status = MsgPackValidation::EXCEEDED;
+                ret.size = static_cast<size_t>(pos - data);
+                return ret;
+            }
+            pos = in.pos();
+            ++ret.nodes;
+            --remaining.back();
+
+            if ((token.type == MsgPack::ARRAY || token.type == MsgPack::OBJECT) && 0 < token.length) {
+                if (options.max_depth <= static_cast<int64_t>(depth)) {
+                    // "exceeded maximum nesting depth."
+                    ret.size = static_cast<size_t>(pos - data);
+                    return ret;
+                }
+                remaining.push((token.type == MsgPack::OBJECT) ? 2 * static_cast<uint64_t>(token.length) : token.length);
+                continue;
             }
         }
+
+        // Close every container the last value completed.
+        while (1 < remaining.size() && remaining.back() == 0) {
+            remaining.pop();
+        }
+        if (remaining.back() == 0) {
+            break;
+        }
     }
-public:
-    explicit MsgPackUint64(uint64_t value) : NumberValue(value) {}
-};
 
-class MsgPackBoolean final : public Value<MsgPack::BOOL, bool> {
-    bool bool_value() const override { return m_value; }
-public:
-    explicit MsgPackBoolean(bool value) : Value(value) {}
-};
+    ret.status = MsgPackValidation::VALID;
+    ret.size = static_cast<size_t>(pos - data);
+    return ret;
+}
 
-class MsgPackString final : public Value<MsgPack::STRING, string> {
-    const string &string_value() const override { return m_value; }
-public:
-    explicit MsgPackString(const string &value) : Value(value) {}
-    explicit MsgPackString(string &&value)      : Value(std::move(value)) {}
-};
+/* * * * * * * * * * * * * * * * * * * *
+ * MsgPackReader::read_numbers()
+ */
 
-class MsgPackArray final : public Value<MsgPack::ARRAY, MsgPack::array> {
-    const MsgPack::array &array_items() const override { return m_value; }
-    const MsgPack & operator[](size_t i) const override;
-public:
-    explicit MsgPackArray(const MsgPack::array &value) : Value(value) {}
-    explicit MsgPackArray(MsgPack::array &&value)      : Value(std::move(value)) {}
-};
+namespace {
+/* decode_run()
+ *
+ * Decode the longest run of values at pos, up to n, that share the encoding
+ * numbers of type T are usually found in: fixints for integers, FLOAT32 or
+ * FLOAT64 for floats. Advance pos past them and return how many there were.
+ */
+template< typename T >
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, size_t>::type
+decode_run(const uint8_t*& pos, const uint8_t* end, T* out, size_t n) {
+    size_t const run = fixint_run(pos, std::min<size_t>(n, static_cast<size_t>(end - pos)));
+    for (size_t i = 0; i < run; ++i) {
+        out[i] = static_cast<T>(static_cast<int8_t>(pos[i]));
+    }
+    pos += run;
+    return run;
+}
 
-class MsgPackBinary final : public Value<MsgPack::BINARY, MsgPack::binary> {
-    const MsgPack::binary &binary_items() const override { return m_value; }
-public:
-    explicit MsgPackBinary(const MsgPack::binary &value) : Value(value) {}
-    explicit MsgPackBinary(MsgPack::binary &&value)      : Value(std::move(value)) {}
-};
+// Negative fixints do not fit an unsigned type, so only positive ones count.
+template< typename T >
+typename std::enable_if<std::is_unsigned<T>::value, size_t>::type
+decode_run(const uint8_t*& pos, const uint8_t* end, T* out, size_t n) {
+    size_t const limit = std::min<size_t>(n, static_cast<size_t>(end - pos));
+    size_t run = 0;
+    while (run < limit && pos[run] <= 0x7f) {
+        out[run] = static_cast<T>(pos[run]);
+        ++run;
+    }
+    pos += run;
+    return run;
+}
 
-class MsgPackObject final : public Value<MsgPack::OBJECT, MsgPack::object> {
-    const MsgPack::object &object_items() const override { return m_value; }
-    const MsgPack & operator[](const string &key) const override;
-public:
-    explicit MsgPackObject(const MsgPack::object &value) : Value(value) {}
-    explicit MsgPackObject(MsgPack::object &&value)      : Value(std::move(value)) {}
-};
+template< typename T >
+typename std::enable_if<std::is_floating_point<T>::value, size_t>::type
+decode_run(const uint8_t*& pos, const uint8_t* end, T* out, size_t n) {
+    uint8_t const tag = (sizeof(T) == sizeof(float)) ? 0xca : 0xcb;
+    size_t const stride = 1 + sizeof(T);
+    size_t const limit = std::min<size_t>(n, static_cast<size_t>(end - pos) / stride);
+    size_t run = 0;
+#ifdef MSGPACK11_SSE2
+    // Gather the payloads of 16 bytes of values with matching tags and
+    // byte-swap them in one step.
+    size_t const per_block = 16 / sizeof(T);
+    for (; run + per_block <= limit; run += per_block) {
+        const uint8_t* const block = pos + run * stride;
+        uint8_t bytes[16];
+        bool same_tag = true;
+        for (size_t k = 0; k < per_block; ++k) {
+            same_tag = same_tag && block[k * stride] == tag;
+            std::memcpy(bytes + k * sizeof(T), block + k * stride + 1, sizeof(T));
+        }
+        if (!same_tag) {
+            break;
+        }
+        __m128i const swapped = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + run),
+                         (sizeof(T) == sizeof(float)) ? byte_swap_epi32(swapped) : byte_swap_epi64(swapped));
+    }
+#endif
+    while (run < limit && pos[run * stride] == tag) {
+        out[run] = load_be<T>(pos + run * stride + 1);
+        ++run;
+    }
+    pos += run * stride;
+    return run;
+}
+}
 
-class MsgPackExtension final : public Value<MsgPack::EXTENSION, MsgPack::extension> {
-    const MsgPack::extension &extension_items() const override { return m_value; }
-public:
-    explicit MsgPackExtension(const MsgPack::extension &value) : Value(value) {}
-    explicit MsgPackExtension(MsgPack::extension &&value)      : Value(std::move(value)) {}
-};
+template< typename T >
+bool MsgPackReader::read_number_array(T * out, size_t n) {
+    if (m_fail) {
+        return false;
+    }
+    size_t i = 0;
+    while (i < n) {
+        i += decode_run(m_pos, m_end, out + i, n - i);
+        if (i < n) {
+            if (!MsgPackCodec<T>::read(*this, out[i])) {
+                return false;
+            }
+            ++i;
+        }
+    }
+    return true;
+}
 
-class MsgPackNull final : public Value<MsgPack::NUL, NullStruct> {
-public:
-    MsgPackNull() : Value({}) {}
-};
+bool MsgPackReader::read_numbers(float * out, size_t n)    { return read_number_array(out, n); }
+bool MsgPackReader::read_numbers(double * out, size_t n)   { return read_number_array(out, n); }
+bool MsgPackReader::read_numbers(int8_t * out, size_t n)   { return read_number_array(out, n); }
+bool MsgPackReader::read_numbers(int16_t * out, size_t n)  { return read_number_array(out, n); }
+bool MsgPackReader::read_numbers(int32_t * out, size_t n)  { return read_number_array(out, n); }
+bool MsgPackReader::read_numbers(int64_t * out, size_t n)  { return read_number_array(out, n); }
+bool MsgPackReader::read_numbers(uint8_t * out, size_t n)  { return read_number_array(out, n); }
+bool MsgPackReader::read_numbers(uint16_t * out, size_t n) { return read_number_array(out, n); }
+bool MsgPackReader::read_numbers(uint32_t * out, size_t n) { return read_number_array(out, n); }
+bool MsgPackReader::read_numbers(uint64_t * out, size_t n) { return read_number_array(out, n); }
 
 /* * * * * * * * * * * * * * * * * * * *
- * Static globals - static-init-safe
+ * MsgPackDocument
  */
-struct Statics {
-    const std::shared_ptr<MsgPackValue> null = make_shared<MsgPackNull>();
-    const std::shared_ptr<MsgPackValue> t = make_shared<MsgPackBoolean>(true);
-    const std::shared_ptr<MsgPackValue> f = make_shared<MsgPackBoolean>(false);
-    const string empty_string;
-    const vector<MsgPack> empty_vector;
-    const map<MsgPack, MsgPack> empty_map;
-    const MsgPack::binary empty_binary;
-    const MsgPack::extension empty_extension;
-    Statics() {}
-};
-
-static const Statics & statics() {
-    static const Statics s {};
-    return s;
-}
 
-static const MsgPack & static_null() {
-    // This has to be separate, not in Statics, because MsgPack() accesses statics().null.
-    static const MsgPack msgpack_null;
-    return msgpack_null;
+bool MsgPackDocument::parse(const char * data, size_t len, std::string & err) {
+    return parse(reinterpret_cast<const uint8_t*>(data), len, err);
 }
 
-/* * * * * * * * * * * * * * * * * * * *
- * Constructors
- */
+bool MsgPackDocument::parse(const uint8_t * data, size_t len, std::string & err) {
+    m_data = nullptr;
+    m_size = 0;
+    m_used = 0;
+    m_tape.clear();
+    m_children.clear();
+    if (data == nullptr) {
+        err = "null input";
+        return false;
+    }
 
-MsgPack::MsgPack() noexcept                        : m_ptr(statics().null) {}
-MsgPack::MsgPack(std::nullptr_t) noexcept          : m_ptr(statics().null) {}
-MsgPack::MsgPack(float value)                      : m_ptr(make_shared<MsgPackFloat>(value)) {}
-MsgPack::MsgPack(double value)                     : m_ptr(make_shared<MsgPackDouble>(value)) {}
-MsgPack::MsgPack(int8_t value)                     : m_ptr(make_shared<MsgPackInt8>(value)) {}
-MsgPack::MsgPack(int16_t value)                    : m_ptr(make_shared<MsgPackInt16>(value)) {}
-MsgPack::MsgPack(int32_t value)                    : m_ptr(make_shared<MsgPackInt32>(value)) {}
-MsgPack::MsgPack(int64_t value)                    : m_ptr(make_shared<MsgPackInt64>(value)) {}
-MsgPack::MsgPack(uint8_t value)                    : m_ptr(make_shared<MsgPackUint8>(value)) {}
-MsgPack::MsgPack(uint16_t value)                   : m_ptr(make_shared<MsgPackUint16>(value)) {}
-MsgPack::MsgPack(uint32_t value)                   : m_ptr(make_shared<MsgPackUint32>(value)) {}
-MsgPack::MsgPack(uint64_t value)                   : m_ptr(make_shared<MsgPackUint64>(value)) {}
-MsgPack::MsgPack(bool value)                       : m_ptr(value ? statics().t : statics().f) {}
-MsgPack::MsgPack(const string &value)              : m_ptr(make_shared<MsgPackString>(value)) {}
-MsgPack::MsgPack(string &&value)                   : m_ptr(make_shared<MsgPackString>(std::move(value))) {}
-MsgPack::MsgPack(const char * value)               : m_ptr(make_shared<MsgPackString>(value)) {}
-MsgPack::MsgPack(const MsgPack::array &values)     : m_ptr(make_shared<MsgPackArray>(values)) {}
-MsgPack::MsgPack(MsgPack::array &&values)          : m_ptr(make_shared<MsgPackArray>(std::move(values))) {}
-MsgPack::MsgPack(const MsgPack::object &values)    : m_ptr(make_shared<MsgPackObject>(values)) {}
-MsgPack::MsgPack(MsgPack::object &&values)         : m_ptr(make_shared<MsgPackObject>(std::move(values))) {}
-MsgPack::MsgPack(const MsgPack::binary &values)    : m_ptr(make_shared<MsgPackBinary>(values)) {}
-MsgPack::MsgPack(MsgPack::binary &&values)         : m_ptr(make_shared<MsgPackBinary>(std::move(values))) {}
-MsgPack::MsgPack(const MsgPack::extension &values) : m_ptr(make_shared<MsgPackExtension>(values)) {}
-MsgPack::MsgPack(MsgPack::extension &&values)      : m_ptr(make_shared<MsgPackExtension>(std::move(values))) {}
+    // Open arrays and objects as (tape index, values still to come, slot in
+    // m_children of the next one).
+    struct Open {
+        uint32_t index;
+        uint64_t remaining;
+        size_t slot;
+    };
+    std::vector<Open> open;
+    BufferInput in(data, data + len);
+    do {
+        TapeEntry entry;
+        entry.offset = static_cast<size_t>(in.pos() - data);
+        MsgPackToken token;
+        bool ok = MsgPackParser::parse_token(in, token) &&
+                  m_tape.size() < std::numeric_limits<uint32_t>::max();
+        uint64_t const values = (token.type == MsgPack::OBJECT) ? 2 * static_cast<uint64_t>(token.length) :
+                                (token.type == MsgPack::ARRAY) ? token.length : 0;
+        // Every value takes at least a byte, so a container declaring more
+        // than the rest of the input holds cannot complete; fail before
+        // making room for its elements.
+        if (ok && in.remaining() < values) {
+            ok = in.take(in.remaining() + 1) != nullptr;
+        }
+        if (!ok) {
+            in.set_fail();
+            MsgPackParser::set_error(in, err);
+            m_tape.clear();
+            m_children.clear();
+            return false;
+        }
+        uint32_t const index = static_cast<uint32_t>(m_tape.size());
+        entry.type = token.type;
+        entry.length = token.length;
+        entry.next = index + 1;
+        entry.children = m_children.size();
+        m_tape.push_back(entry);
+        if (!open.empty()) {
+            m_children[open.back().slot++] = index;
+        }
 
-/* * * * * * * * * * * * * * * * * * * *
- * Accessors
- */
+        if (0 < values) {
+            m_children.resize(m_children.size() + static_cast<size_t>(values));
+            open.push_back(Open{ index, values, entry.children });
+            continue;
+        }
+        // A value is complete; close every container it completes.
+        while (!open.empty() && --open.back().remaining == 0) {
+            m_tape[open.back().index].next = static_cast<uint32_t>(m_tape.size());
+            open.pop_back();
+        }
+    } while (!open.empty());
 
-MsgPack::Type MsgPack::type()                           const { return m_ptr->type(); }
-double MsgPack::number_value()                          const { return m_ptr->float64_value(); }
-float MsgPack::float32_value()                          const { return m_ptr->float32_value(); }
-double MsgPack::float64_value()                         const { return m_ptr->float64_value(); }
-int32_t MsgPack::int_value()                            const { return m_ptr->int32_value(); }
-int8_t MsgPack::int8_value()                            const { return m_ptr->int8_value(); }
-int16_t MsgPack::int16_value()                          const { return m_ptr->int16_value(); }
-int32_t MsgPack::int32_value()                          const { return m_ptr->int32_value(); }
-int64_t MsgPack::int64_value()                          const { return m_ptr->int64_value(); }
-uint8_t MsgPack::uint8_value()                          const { return m_ptr->uint8_value(); }
-uint16_t MsgPack::uint16_value()                        const { return m_ptr->uint16_value(); }
-uint32_t MsgPack::uint32_value()                        const { return m_ptr->uint32_value(); }
-uint64_t MsgPack::uint64_value()                        const { return m_ptr->uint64_value(); }
-bool MsgPack::bool_value()                              const { return m_ptr->bool_value(); }
-const string & MsgPack::string_value()                  const { return m_ptr->string_value(); }
-const vector<MsgPack>& MsgPack::array_items()           const { return m_ptr->array_items(); }
-const MsgPack::binary& MsgPack::binary_items()          const { return m_ptr->binary_items(); }
-const MsgPack::extension& MsgPack::extension_items()    const { return m_ptr->extension_items(); }
-const map<MsgPack, MsgPack> & MsgPack::object_items()   const { return m_ptr->object_items(); }
-const MsgPack & MsgPack::operator[] (size_t i)          const { return (*m_ptr)[i]; }
-const MsgPack & MsgPack::operator[] (const string &key) const { return (*m_ptr)[key]; }
-
-double                        MsgPackValue::number_value()              const { return 0.0; }
-float                         MsgPackValue::float32_value()             const { return 0.0f; }
-double                        MsgPackValue::float64_value()             const { return 0.0; }
-int32_t                       MsgPackValue::int_value()                 const { return 0; }
-int8_t                        MsgPackValue::int8_value()                const { return 0; }
-int16_t                       MsgPackValue::int16_value()               const { return 0; }
-int32_t                       MsgPackValue::int32_value()               const { return 0; }
-int64_t                       MsgPackValue::int64_value()               const { return 0; }
-uint8_t                       MsgPackValue::uint8_value()               const { return 0; }
-uint16_t                      MsgPackValue::uint16_value()              const { return 0; }
-uint32_t                      MsgPackValue::uint32_value()              const { return 0; }
-uint64_t                      MsgPackValue::uint64_value()              const { return 0; }
-bool                          MsgPackValue::bool_value()                const { return false; }
-const string &                MsgPackValue::string_value()              const { return statics().empty_string; }
-const vector<MsgPack> &       MsgPackValue::array_items()               const { return statics().empty_vector; }
-const map<MsgPack, MsgPack> & MsgPackValue::object_items()              const { return statics().empty_map; }
-const MsgPack::binary & MsgPackValue::binary_items()                    const { return statics().empty_binary; }
-const MsgPack::extension & MsgPackValue::extension_items()              const { return statics().empty_extension; }
-const MsgPack &               MsgPackValue::operator[] (size_t)         const { return static_null(); }
-const MsgPack &               MsgPackValue::operator[] (const string &) const { return static_null(); }
+    m_data = data;
+    m_size = len;
+    m_used = static_cast<size_t>(in.pos() - data);
+    return true;
+}
 
-const MsgPack & MsgPackObject::operator[] (const string &key) const {
-    auto iter = m_value.find(key);
-    return (iter == m_value.end()) ? static_null() : iter->second;
+MsgPackElement MsgPackDocument::root() const {
+    return m_tape.empty() ? MsgPackElement() : MsgPackElement(this, 0);
 }
-const MsgPack & MsgPackArray::operator[] (size_t i) const {
-    if (i >= m_value.size()) return static_null();
-    else return m_value[i];
+
+size_t MsgPackDocument::parsed_size() const {
+    return m_used;
 }
 
 /* * * * * * * * * * * * * * * * * * * *
- * Comparison
+ * MsgPackElement
  */
 
-bool MsgPack::operator== (const MsgPack &other) const {
-    return m_ptr->equals(other.m_ptr.get());
+MsgPack::Type MsgPackElement::type() const {
+    return m_doc ? m_doc->m_tape[m_index].type : MsgPack::NUL;
 }
 
-bool MsgPack::operator< (const MsgPack &other) const {
-    return m_ptr->less(other.m_ptr.get());
+size_t MsgPackElement::size() const {
+    switch (type()) {
+        case MsgPack::STRING:    // fall through
+        case MsgPack::BINARY:    // fall through
+        case MsgPack::EXTENSION: // fall through
+        case MsgPack::ARRAY:     // fall through
+        case MsgPack::OBJECT:    return m_doc->m_tape[m_index].length;
+        default:                 return 0;
+    }
 }
 
-namespace {
-/* MsgPackParser
- *
- * Object that tracks all state of an in-progress parse.
- */
-namespace MsgPackParser {
-    MsgPack parse_msgpack(std::istream& is, int depth);
-    
-    template< typename T >
-    void read_bytes(std::istream& is, T& bytes)
-    {
-        static_assert(std::is_fundamental<T>::value,
-            "byte read not guaranteed for non-primitive types");
-        int n = sizeof(T);
-        
-        int const offsets[] = {(n-1), 0};
-        int const directions[] = {-1, 1};
-        
-        uint8_t* dst_ptr = reinterpret_cast<uint8_t*>(&bytes) + offsets[static_cast<int>(is_big_endian)];
-        int const dir = directions[static_cast<int>(is_big_endian)];
-        for(int i = 0; i < n; ++i)
-        {
-            *dst_ptr = is.get();
-            dst_ptr += dir;
-        }
-        
-        // NB: if the read fails it's prefered to return 0 rather than
-        //      corrupted value, for example in the case of reading data size.
-        if (is.fail() || is.eof()) {
-            bytes = 0;
-        }
-    }
+bool MsgPackElement::token(MsgPackToken & token) const {
+    const uint8_t * const begin = m_doc->m_data + m_doc->m_tape[m_index].offset;
+    BufferInput in(begin, m_doc->m_data + m_doc->m_size);
+    return MsgPackParser::parse_token(in, token);
+}
 
-    /* fail(msg, err_ret = MsgPack())
-     *
-     * Mark this parse as m_failed.
-     */
-    MsgPack fail(std::istream& is) {
-        is.setstate(std::ios::failbit);
+MsgPack MsgPackElement::scalar() const {
+    MsgPackToken tok;
+    bool const is_scalar = (type() & MsgPack::NUMBER) || type() == MsgPack::BOOL;
+    if (!is_scalar || !token(tok)) {
         return MsgPack();
     }
+    HeapNodes nodes;
+    return MsgPackParser::parse_value(tok, nodes);
+}
 
-    MsgPack parse_invalid(std::istream& is, uint8_t, int) {
-        return fail(is);
-    }
+bool MsgPackElement::bool_value()      const { return scalar().bool_value(); }
+double MsgPackElement::number_value()  const { return scalar().number_value(); }
+int32_t MsgPackElement::int_value()    const { return scalar().int_value(); }
+int64_t MsgPackElement::int64_value()  const { return scalar().int64_value(); }
+uint64_t MsgPackElement::uint64_value() const { return scalar().uint64_value(); }
 
-    MsgPack parse_nil(std::istream&, uint8_t, int) {
-        return MsgPack();
+const uint8_t * MsgPackElement::payload(MsgPack::Type expected) const {
+    MsgPackToken tok;
+    if (type() != expected || !token(tok)) {
+        return nullptr;
     }
+    return tok.data;
+}
 
-    MsgPack parse_bool(std::istream&, uint8_t first_byte, int) {
-        return MsgPack(first_byte == 0xc3);
-    }
+const char * MsgPackElement::string_data() const {
+    return reinterpret_cast<const char*>(payload(MsgPack::STRING));
+}
 
-    template< typename T >
-    MsgPack parse_arith(std::istream& is, uint8_t, int) {
-        T tmp;
-        read_bytes(is, tmp);
-        return MsgPack(tmp);
-    }
+const uint8_t * MsgPackElement::binary_data() const {
+    return payload(MsgPack::BINARY);
+}
 
-    inline  std::string parse_string_impl(std::istream& is, uint32_t bytes) {
-        std::string ret;
-        ret.resize(bytes);
-        is.read(&ret[0], bytes);
-        return ret;
-    }
+const uint8_t * MsgPackElement::extension_data() const {
+    return payload(MsgPack::EXTENSION);
+}
 
-    template< typename T >
-    MsgPack parse_string(std::istream& is, uint8_t, int) {
-        T bytes;
-        read_bytes(is, bytes);
-        return MsgPack(parse_string_impl(is, static_cast<uint32_t>(bytes)));
+int8_t MsgPackElement::extension_type() const {
+    MsgPackToken tok;
+    if (type() != MsgPack::EXTENSION || !token(tok)) {
+        return 0;
     }
+    return tok.ext_type;
+}
 
-    MsgPack::array parse_array_impl(std::istream& is, uint32_t bytes, int depth) {
-        MsgPack::array res;
-        res.reserve(bytes);
+// Return the i-th value stored below this array or object, counting keys and
+// values of an object separately.
+MsgPackElement MsgPackElement::child(size_t i) const {
+    return MsgPackElement(m_doc, m_doc->m_children[m_doc->m_tape[m_index].children + i]);
+}
 
-        for(uint32_t i = 0; i < bytes; ++i) {
-            res.push_back(parse_msgpack(is, depth));
-        }
-        return res;
+MsgPackElement MsgPackElement::operator[](size_t i) const {
+    if (type() != MsgPack::ARRAY || size() <= i) {
+        return MsgPackElement();
     }
+    return child(i);
+}
 
-    template< typename T >
-    MsgPack parse_array(std::istream& is, uint8_t, int depth) {
-        T bytes;
-        read_bytes(is, bytes);
-        return MsgPack(parse_array_impl(is, static_cast<uint32_t>(bytes), depth));
+MsgPackElement MsgPackElement::key(size_t i) const {
+    if (type() != MsgPack::OBJECT || size() <= i) {
+        return MsgPackElement();
     }
+    return child(2 * i);
+}
 
-    MsgPack::object parse_object_impl(std::istream& is, uint32_t bytes, int depth) {
-        MsgPack::object res;
-
-        for(uint32_t i = 0; i < bytes; ++i) {
-            MsgPack key = parse_msgpack(is, depth);
-            MsgPack value = parse_msgpack(is, depth);
-            res.insert(std::make_pair(std::move(key), std::move(value)));
-        }
-        return res;
+MsgPackElement MsgPackElement::value(size_t i) const {
+    if (type() != MsgPack::OBJECT || size() <= i) {
+        return MsgPackElement();
     }
+    return child(2 * i + 1);
+}
 
-    template< typename T >
-    MsgPack parse_object(std::istream& is, uint8_t, int depth) {
-        T bytes;
-        read_bytes(is, bytes);
-        return MsgPack(parse_object_impl(is, static_cast<uint32_t>(bytes), depth));
-    }
+MsgPackElement MsgPackElement::operator[](const std::string & key) const {
+    return get(key.data(), key.size());
+}
 
-    MsgPack::binary parse_binary_impl(std::istream& is, uint32_t bytes) {
-        MsgPack::binary ret;
-        ret.resize(bytes);
-        is.read(reinterpret_cast<char*>(ret.data()), bytes);
-        return ret;
+MsgPackElement MsgPackElement::get(const char * key, size_t len) const {
+    if (type() != MsgPack::OBJECT) {
+        return MsgPackElement();
     }
-
-    template< typename T >
-    MsgPack parse_binary(std::istream& is, uint8_t, int) {
-        T bytes;
-        read_bytes(is, bytes);
-        return MsgPack(parse_binary_impl(is, static_cast<uint32_t>(bytes)));
+    // Keys are in wire order, so this is a linear scan that only decodes
+    // string keys of the right length.
+    uint32_t index = m_index + 1;
+    for (size_t n = size(); 0 < n; --n) {
+        MsgPackElement const k(m_doc, index);
+        uint32_t const value_index = m_doc->m_tape[index].next;
+        if (k.type() == MsgPack::STRING && k.size() == len &&
+            (len == 0 || std::memcmp(k.string_data(), key, len) == 0)) {
+            return MsgPackElement(m_doc, value_index);
+        }
+        index = m_doc->m_tape[value_index].next;
     }
+    return MsgPackElement();
+}
 
-    template< typename T >
-    MsgPack parse_extension(std::istream& is, uint8_t, int) {
-        T bytes;
-        read_bytes(is, bytes);
-        uint8_t type;
-        read_bytes(is, type);
-        const MsgPack::binary data =  parse_binary_impl(is, static_cast<uint32_t>(bytes));
-        return MsgPack(std::make_tuple(type, std::move(data)));
+MsgPack MsgPackElement::to_msgpack() const {
+    if (!m_doc) {
+        return MsgPack();
     }
+    const uint8_t * const begin = m_doc->m_data + m_doc->m_tape[m_index].offset;
+    BufferInput in(begin, m_doc->m_data + m_doc->m_size);
+    // The document put no limit on depth, and neither does the conversion.
+    HeapNodes nodes;
+    nodes.depth_limit = std::numeric_limits<int>::max();
+    return MsgPackParser::parse_msgpack(in, nodes, 0);
+}
 
-    MsgPack parse_pos_fixint(std::istream&, uint8_t first_byte, int) {
-        return MsgPack( first_byte );
-    }
+/* * * * * * * * * * * * * * * * * * * *
+ * MsgPackIncrementalParser
+ */
 
-    MsgPack parse_fixobject(std::istream& is, uint8_t first_byte, int depth) {
-        uint32_t const bytes = first_byte & 0x0f;
-        return MsgPack(parse_object_impl(is, bytes, depth));
-    }
+// Upper bound on the elements reserved for a container up front. The declared
+// count comes from the wire and is not trusted until the elements arrive.
+static const uint32_t max_incremental_reserve = 1024;
 
-    MsgPack parse_fixarray(std::istream& is, uint8_t first_byte, int depth) {
-        uint32_t const bytes = first_byte & 0x0f;
-        return MsgPack(parse_array_impl(is, bytes, depth));
-    }
+// Longest token header: the type byte and a 64-bit number.
+static const size_t max_token_header = 9;
 
-    MsgPack parse_fixstring(std::istream& is, uint8_t first_byte, int) {
-        uint32_t const bytes = first_byte & 0x1f;
-        return MsgPack(parse_string_impl(is, bytes));
-    }
+bool MsgPackIncrementalParser::feed(const char * data, size_t len) {
+    return feed(reinterpret_cast<const uint8_t*>(data), len);
+}
 
-    MsgPack parse_neg_fixint(std::istream&, uint8_t first_byte, int) {
-        return MsgPack(*reinterpret_cast<int8_t*>(&first_byte));
+bool MsgPackIncrementalParser::feed(const uint8_t * data, size_t len) {
+    if (m_fail) {
+        return false;
     }
 
-    MsgPack parse_fixext(std::istream& is, uint8_t first_byte, int) {
-        uint8_t type;
-        read_bytes(is, type);
-        uint32_t const BYTES = 1 << (first_byte - 0xd4u);
-        const MsgPack::binary data = parse_binary_impl(is, BYTES);
-        return MsgPack(std::make_tuple(type, std::move(data)));
+    // Complete the token held back by the last call, adding only the bytes
+    // it still needs: up to the end of its payload once its header is in,
+    // up to the longest header before that.
+    while (!m_pending.empty() && 0 < len) {
+        size_t const wanted = (0 < m_token_size ? m_token_size : max_token_header) - m_pending.size();
+        size_t const n = std::min(len, wanted);
+        m_pending.insert(m_pending.end(), data, data + n);
+        data += n;
+        len -= n;
+        size_t const used = consume(m_pending.data(), m_pending.size());
+        m_pending.erase(m_pending.begin(), m_pending.begin() + used);
+        if (m_fail) {
+            return false;
+        }
     }
 
-    /* parse_msgpack()
-     *
-     * Parse a JSON object.
-     */
-    MsgPack parse_msgpack(std::istream& is, int depth) {
-        static const std::array< MsgPack(*)(std::istream&, uint8_t, int), 256 > parsers = [](){
-            using parser_template_element_type = std::tuple<uint8_t, MsgPack(*)(std::istream&,uint8_t,int)>;
-            std::array< parser_template_element_type, 36 > const parser_template{{
-                parser_template_element_type{ 0x7fu, &MsgPackParser::parse_pos_fixint},
-                parser_template_element_type{ 0x8fu, &MsgPackParser::parse_fixobject},
-                parser_template_element_type{ 0x9fu, &MsgPackParser::parse_fixarray},
-                parser_template_element_type{ 0xbfu, &MsgPackParser::parse_fixstring},
-                parser_template_element_type{ 0xc0u, &MsgPackParser::parse_nil},
-                parser_template_element_type{ 0xc1u, &MsgPackParser::parse_invalid},
-                parser_template_element_type{ 0xc3u, &MsgPackParser::parse_bool},
-                parser_template_element_type{ 0xc4u, &MsgPackParser::parse_binary<uint8_t>},
-                parser_template_element_type{ 0xc5u, &MsgPackParser::parse_binary<uint16_t>},
-                parser_template_element_type{ 0xc6u, &MsgPackParser::parse_binary<uint32_t>},
-                parser_template_element_type{ 0xc7u, &MsgPackParser::parse_extension<uint8_t>},
-                parser_template_element_type{ 0xc8u, &MsgPackParser::parse_extension<uint16_t>},
-                parser_template_element_type{ 0xc9u, &MsgPackParser::parse_extension<uint32_t>},
-                parser_template_element_type{ 0xcau, &MsgPackParser::parse_arith<float>},
-                parser_template_element_type{ 0xcbu, &MsgPackParser::parse_arith<double>},
-                parser_template_element_type{ 0xccu, &MsgPackParser::parse_arith<uint8_t>},
-                parser_template_element_type{ 0xcdu, &MsgPackParser::parse_arith<uint16_t>},
-                parser_template_element_type{ 0xceu, &MsgPackParser::parse_arith<uint32_t>},
-                parser_template_element_type{ 0xcfu, &MsgPackParser::parse_arith<uint64_t>},
-                parser_template_element_type{ 0xd0u, &MsgPackParser::parse_arith<int8_t>},
-                parser_template_element_type{ 0xd1u, &MsgPackParser::parse_arith<int16_t>},
-                parser_template_element_type{ 0xd2u, &MsgPackParser::parse_arith<int32_t>},
-                parser_template_element_type{ 0xd3u, &MsgPackParser::parse_arith<int64_t>},
-                parser_template_element_type{ 0xd8u, &MsgPackParser::parse_fixext},
-                parser_template_element_type{ 0xd9u, &MsgPackParser::parse_string<uint8_t>},
-                parser_template_element_type{ 0xdau, &MsgPackParser::parse_string<uint16_t>},
-                parser_template_element_type{ 0xdbu, &MsgPackParser::parse_string<uint32_t>},
-                parser_template_element_type{ 0xdcu, &MsgPackParser::parse_array<uint16_t>},
-                parser_template_element_type{ 0xddu, &MsgPackParser::parse_array<uint32_t>},
-                parser_template_element_type{ 0xdeu, &MsgPackParser::parse_object<uint16_t>},
-                parser_template_element_type{ 0xdfu, &MsgPackParser::parse_object<uint32_t>},
-                parser_template_element_type{ 0xffu, &MsgPackParser::parse_neg_fixint}
-            }};
+    if (0 < len) {
+        // Parse straight from the caller's chunk and keep only the tail of an
+        // incomplete token.
+        size_t const used = consume(data, len);
+        if (m_fail) {
+            return false;
+        }
+        m_pending.assign(data + used, data + len);
+    }
+    return true;
+}
 
-            std::array< MsgPack(*)(std::istream&, uint8_t, int), 256 > parsers;
-            int i = 0;
-            std::for_each(std::begin(parser_template),
-                         std::end(parser_template),
-                         [&parsers,&i]( parser_template_element_type const& element ) {
-                            int upto = std::get<0>( element );
-                            auto parser = std::get<1>( element );
-                            while(i <= upto)
-                            {
-                                parsers[i] = parser;
-                                ++i;
-                            }
-                         });
-            return parsers;
-        }();
+size_t MsgPackIncrementalParser::consume(const uint8_t * data, size_t len) {
+    const uint8_t * pos = data;
+    const uint8_t * const end = data + len;
+    m_token_size = 0;
+    while (pos != end) {
+        ChunkInput input(pos, end);
+        MsgPackToken token;
+        if (!MsgPackParser::parse_token(input, token)) {
+            if (!input.eof()) {
+                m_fail = true;
+                break;
+            }
+            // Running out of input only means the token is not complete yet,
+            // unless what its header declares is already over a limit.
+            if (input.wanted_end() != nullptr) {
+                m_token_size = static_cast<size_t>(input.wanted_end() - pos);
+                m_exceeded = m_options.max_payload < token.length;
+            }
+            m_exceeded = m_exceeded ||
+                m_options.max_bytes - m_bytes < std::max(m_token_size, static_cast<size_t>(end - pos));
+            m_fail = m_exceeded;
+            break;
+        }
 
-        if (max_depth < depth) {
-            // "exceeded maximum nesting depth."
-            return fail(is);
+        size_t const used = static_cast<size_t>(input.pos() - pos);
+        if (m_nodes == m_options.max_nodes || m_options.max_bytes - m_bytes < used ||
+            length_limit(token, m_options.max_elements, m_options.max_payload) < token.length) {
+            m_exceeded = true;
+            m_fail = true;
+            break;
         }
-        
-        uint8_t const first_byte = is.get();
-        // check for fail/eof after get() as eof only set after read past the end
-        if (is.fail() || is.eof()) {
-            return fail(is);
+        ++m_nodes;
+        m_bytes += used;
+        pos = input.pos();
+
+        if ((token.type == MsgPack::ARRAY || token.type == MsgPack::OBJECT) && 0 < token.length) {
+            if (m_options.max_depth <= static_cast<int64_t>(m_stack.size())) {
+                // "exceeded maximum nesting depth."
+                m_fail = true;
+                break;
+            }
+            m_stack.emplace_back();
+            Frame & frame = m_stack.back();
+            frame.is_object = token.type == MsgPack::OBJECT;
+            frame.remaining = frame.is_object ? 2 * static_cast<uint64_t>(token.length) : token.length;
+            frame.items.reserve(static_cast<size_t>(std::min<uint64_t>(frame.remaining, max_incremental_reserve)));
+        } else if (token.type == MsgPack::ARRAY) {
+            push(MsgPack(MsgPack::array()));
+        } else if (token.type == MsgPack::OBJECT) {
+            push(MsgPack(MsgPack::object()));
+        } else {
+            HeapNodes nodes;
+            push(MsgPackParser::parse_value(token, nodes));
         }
-        
-        MsgPack ret = (*parsers[first_byte])(is, first_byte, depth + 1);
-        
-        if (is.fail() || is.eof()) {
-            return fail(is);
+        if (m_stack.empty()) {
+            // A top-level value is complete; the limits start over.
+            m_nodes = 0;
+            m_bytes = 0;
         }
-        return ret;
     }
-};
-
-}//namespace {
-
-std::istream& operator>>(std::istream& is, MsgPack& msgpack) {
-    msgpack = MsgPackParser::parse_msgpack(is, 0);
-    return is;
+    return static_cast<size_t>(pos - data);
 }
 
-MsgPack MsgPack::parse(std::istream& is) {
-    return MsgPackParser::parse_msgpack(is, 0);
+void MsgPackIncrementalParser::push(MsgPack && value) {
+    while (!m_stack.empty()) {
+        Frame & frame = m_stack.back();
+        frame.items.push_back(std::move(value));
+        if (0 < --frame.remaining) {
+            return;
+        }
+
+        if (frame.is_object) {
+            std::vector<std::pair<MsgPack, MsgPack>> items;
+            items.reserve(frame.items.size() / 2);
+            for (size_t i = 0; i < frame.items.size(); i += 2) {
+                items.emplace_back(std::move(frame.items[i]), std::move(frame.items[i + 1]));
+            }
+            value = MsgPack(MsgPack::object(std::move(items)));
+        } else {
+            value = MsgPack(std::move(frame.items));
+        }
+        m_stack.pop_back();
+    }
+    m_ready.push_back(std::move(value));
 }
 
-MsgPack MsgPack::parse(std::istream& is, std::string &err) {
-    MsgPack ret = MsgPack::parse(is);
-    if (is.eof()) {
-        err = "end of buffer.";
-    } else if (is.fail()) {
-        err = "format error.";
+bool MsgPackIncrementalParser::next(MsgPack & msgpack) {
+    if (m_ready.empty()) {
+        return false;
     }
-    return ret;
+    msgpack = std::move(m_ready.front());
+    m_ready.pop_front();
+    return true;
 }
 
-MsgPack MsgPack::parse(const std::string &in, string &err) {
-    std::stringstream ss(in);
-    return MsgPack::parse(ss, err);
+void MsgPackIncrementalParser::reset() {
+    m_pending.clear();
+    m_stack.clear();
+    m_ready.clear();
+    m_fail = false;
+    m_exceeded = false;
+    m_nodes = 0;
+    m_bytes = 0;
+    m_token_size = 0;
 }
 
 // Documented in msgpack.hpp
 vector<MsgPack> MsgPack::parse_multi(const string &in,
                                      std::string::size_type &parser_stop_pos,
                                      string &err) {
-    std::stringstream ss(in);
-    
+    const uint8_t* const begin = reinterpret_cast<const uint8_t*>(in.data());
+    BufferInput input(begin, begin + in.size());
+
+    parser_stop_pos = 0;
+    HeapNodes nodes;
     vector<MsgPack> msgpack_vec;
-    while (static_cast<size_t>(ss.tellg()) != in.size() && !ss.eof() && !ss.fail()) {
-        auto next = MsgPack::parse(ss, err);
-        if (!ss.fail()) {
+    while (static_cast<size_t>(input.pos() - begin) != in.size() && !input.failed()) {
+        auto next = MsgPackParser::parse_msgpack(input, nodes, 0);
+        MsgPackParser::set_error(input, err);
+        if (!input.failed()) {
             msgpack_vec.emplace_back(std::move(next));
-            parser_stop_pos = ss.tellg();
+            parser_stop_pos = input.pos() - begin;
+        }
+    }
+
+    return msgpack_vec;
+}
+
+vector<MsgPack> MsgPack::parse_multi(const string &in,
+                                     std::string::size_type &parser_stop_pos,
+                                     string &err,
+                                     unsigned threads) {
+    return parse_multi(in.data(), in.size(), parser_stop_pos, err, threads);
+}
+
+vector<MsgPack> MsgPack::parse_multi(const char * in,
+                                     size_t len,
+                                     size_t &parser_stop_pos,
+                                     string &err,
+                                     unsigned threads) {
+    return parse_multi(in, len, parser_stop_pos, err, threads, ParseOptions());
+}
+
+vector<MsgPack> MsgPack::parse_multi(const char * in,
+                                     size_t len,
+                                     size_t &parser_stop_pos,
+                                     string &err,
+                                     unsigned threads,
+                                     const ParseOptions &options) {
+    const uint8_t* const begin = reinterpret_cast<const uint8_t*>(in);
+    parser_stop_pos = 0;
+    if (begin == nullptr) {
+        err = "null input";
+        return vector<MsgPack>();
+    }
+
+    // Find where each value ends. Decoding fails exactly where validation
+    // does, so the serial stop position and error carry over.
+    vector<size_t> ends;
+    while (parser_stop_pos != len) {
+        MsgPackValidation const frame = validate(begin + parser_stop_pos, len - parser_stop_pos, options);
+        if (frame.status != MsgPackValidation::VALID) {
+            err = (frame.status == MsgPackValidation::INCOMPLETE) ? "end of buffer." :
+                  (frame.status == MsgPackValidation::EXCEEDED) ? "exceeded parse limit." : "format error.";
+            break;
+        }
+        parser_stop_pos += frame.size;
+        ends.push_back(parser_stop_pos);
+    }
+
+    size_t const chunk_count = std::max<size_t>(1, std::min<size_t>(
+        std::min<size_t>(thread_count(threads), parser_stop_pos / min_parallel_chunk), ends.size()));
+
+    // Split the values into chunk_count runs of about equal byte size.
+    vector<size_t> chunk_first(1, 0);
+    for (size_t i = 0; i < ends.size() && chunk_first.size() < chunk_count; ++i) {
+        if (parser_stop_pos * chunk_first.size() / chunk_count <= ends[i]) {
+            chunk_first.push_back(i + 1);
         }
     }
-        
+    chunk_first.push_back(ends.size());
+
+    vector<MsgPack> msgpack_vec(ends.size());
+    auto decode = [&](size_t chunk) {
+        size_t const first = chunk_first[chunk];
+        size_t const last = chunk_first[chunk + 1];
+        BufferInput input(begin + (first == 0 ? 0 : ends[first - 1]), begin + parser_stop_pos);
+        // Validation has checked the limits of each value; only the depth
+        // is checked again while decoding.
+        HeapNodes nodes;
+        nodes.depth_limit = options.max_depth;
+        for (size_t i = first; i < last; ++i) {
+            msgpack_vec[i] = MsgPackParser::parse_msgpack(input, nodes, 0);
+        }
+    };
+
+    run_chunks(chunk_first.size() - 1, decode);
     return msgpack_vec;
 }
 
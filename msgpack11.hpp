@@ -1,14 +1,23 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <deque>
 #include <map>
 #include <memory>
 #include <initializer_list>
 #include <istream>
 #include <ostream>
 #include <sstream>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 
 #ifdef _MSC_VER
@@ -26,6 +35,9 @@
 namespace msgpack11 {
 
 class MsgPackValue;
+class MsgPackVisitor;
+class MsgPackExtensionCodec;
+class MsgPackExtensionRegistry;
 
 class MsgPack final {
 public:
@@ -55,12 +67,39 @@ public:
 
     // Array and object typedefs
     typedef std::vector<MsgPack> array;
-    typedef std::map<MsgPack, MsgPack> object;
+    class object;
 
     // Binary and extension typedefs
     typedef std::vector<uint8_t> binary;
     typedef std::tuple<int8_t, binary> extension;
 
+    // Point in time carried by the timestamp extension, type -1. It is
+    // encoded as the smallest of the spec's 32, 64 and 96 bit forms that
+    // holds it.
+    struct timestamp {
+        // Seconds since 1970-01-01 00:00:00 UTC.
+        int64_t seconds;
+        // Nanoseconds within the second, below 1000000000.
+        uint32_t nanoseconds;
+
+        // Decode the payload of a type -1 extension. Return false if it is
+        // not 4, 8 or 12 bytes long or the nanoseconds are out of range.
+        static bool decode(const uint8_t * data, size_t len, timestamp & out);
+        // Write the payload in its smallest form to out, which has room for
+        // 12 bytes, and return its length. Nanoseconds of 1000000000 or
+        // more are carried into the seconds first, as the spec allows no
+        // payload with them.
+        size_t encode(uint8_t * out) const;
+
+        bool operator==(const timestamp & other) const {
+            return seconds == other.seconds && nanoseconds == other.nanoseconds;
+        }
+        bool operator!=(const timestamp & other) const { return !(*this == other); }
+        bool operator<(const timestamp & other) const {
+            return seconds < other.seconds || (seconds == other.seconds && nanoseconds < other.nanoseconds);
+        }
+    };
+
     // Constructors for the various types of JSON value.
     MsgPack() noexcept;                // NUL
     MsgPack(std::nullptr_t) noexcept;  // NUL
@@ -86,6 +125,7 @@ public:
     MsgPack(binary &&values);          // BINARY
     MsgPack(const extension &values);  // EXTENSION
     MsgPack(extension &&values);       // EXTENSION
+    MsgPack(const timestamp &value);   // EXTENSION
 
     // Implicit constructor: anything with a to_msgpack() function.
     template <class T, class = decltype(&T::to_msgpack)>
@@ -137,6 +177,8 @@ public:
     bool is_binary()    const { return type() == BINARY; }
     bool is_object()    const { return type() == OBJECT; }
     bool is_extension() const { return type() == EXTENSION; }
+    // Return true if this is an extension holding a valid timestamp.
+    bool is_timestamp() const;
 
     // Return the enclosed value if this is a number, 0 otherwise. Note that msgpack11 does not
     // distinguish between integer and non-integer numbers - number_value() and int_value()
@@ -160,31 +202,63 @@ public:
     const std::string &string_value() const;
     // Return the enclosed std::vector if this is an array, or an empty vector otherwise.
     const array &array_items() const;
-    // Return the enclosed std::map if this is an object, or an empty map otherwise.
+    // Return the enclosed map if this is an object, or an empty map otherwise.
     const object &object_items() const;
     // Return the enclosed std::vector if this is an binary, or an empty map otherwise.
     const binary &binary_items() const;
+    // Return the bytes of a string or binary without copying them, or nullptr
+    // and 0 for any other type. Borrowed values point into the parse input;
+    // for them string_value() and binary_items() make a copy on first use.
+    const char *string_data() const;
+    size_t string_size() const;
+    const uint8_t *binary_data() const;
+    size_t binary_size() const;
     // Return the enclosed std::tuple if this is an extension, or an empty map otherwise.
     const extension &extension_items() const;
+    // Return the enclosed timestamp if is_timestamp(), { 0, 0 } otherwise.
+    timestamp timestamp_value() const;
+    // Build an EXTENSION that holds value itself rather than its payload,
+    // for a T with a MsgPackExtensionTraits specialization. It dumps and
+    // compares like the extension of its encoded payload.
+    template <class T> static MsgPack make_extension(const T & value);
+    // Return the value held by an extension that was built by
+    // make_extension<T>() or decoded by the codec of T during parse, nullptr
+    // otherwise.
+    template <class T> const T * extension_value() const;
 
     // Return a reference to arr[i] if this is an array, MsgPack() otherwise.
     const MsgPack & operator[](size_t i) const;
     // Return a reference to obj[key] if this is an object, MsgPack() otherwise.
+    // String keys are compared in place, without building a MsgPack for them.
     const MsgPack & operator[](const std::string &key) const;
+    template <class T, typename std::enable_if<
+        std::is_same<T, const char *>::value || std::is_same<T, char *>::value,
+            int>::type = 0>
+    const MsgPack & operator[](T key) const { return get(key, std::char_traits<char>::length(key)); }
+#if __cplusplus >= 201703L
+    const MsgPack & operator[](std::string_view key) const;
+#endif
+    // Return a reference to obj[std::string(key, len)] if this is an object,
+    // MsgPack() otherwise.
+    const MsgPack & get(const char *key, size_t len) const;
+
+    // Serialize. The buffer overloads replace the contents of out but keep its
+    // capacity, so a reused buffer does not reallocate.
+    void dump(std::string &out) const;
+    void dump(binary &out) const;
+    std::string dump() const;
+    // Serialize like dump(out), encoding the elements of a large top-level
+    // array or object on up to threads threads (0 picks
+    // std::thread::hardware_concurrency()). The output is byte-identical.
+    void dump(std::string &out, unsigned threads) const;
+    void dump(binary &out, unsigned threads) const;
+    // Serialize, appending to out.
+    void dump_append(std::string &out) const;
+    void dump_append(binary &out) const;
+    // Return the exact number of bytes dump() produces. The result is cached on
+    // arrays and objects, so sizing an already sized subtree is O(1).
+    size_t encoded_size() const;
 
-    // Serialize.
-    void dump(std::string &out) const {
-        std::stringstream ss;
-        ss << *this;
-        out = ss.str();
-    }
-    
-    std::string dump() const {
-        std::stringstream ss;
-        ss << *this;
-        return ss.str();
-    }
-    
     friend std::ostream& operator<<(std::ostream& os, const MsgPack& msgpack);
     // Parse. If parse fails, set msgpack to MsgPack() and
     // sets failbit on stream.
@@ -199,14 +273,85 @@ public:
     // Parse (without the need to default initialise object first).
     // If parse fails, return MsgPack() and sets failbit on stream.
     static MsgPack parse(std::istream& is);
-    static MsgPack parse(const char * in, size_t len, std::string & err) {
-        if (in) {
-            return parse(std::string(in,in+len), err);
-        } else {
-            err = "null input";
-            return nullptr;
-        }
-    }
+    // Parse directly from a memory buffer without copying it. If parse fails,
+    // return MsgPack() and assign an error message to err.
+    static MsgPack parse(const char * in, size_t len, std::string & err);
+    static MsgPack parse(const uint8_t * in, size_t len, std::string & err);
+    // Options for parsing from a memory buffer.
+    struct ParseOptions {
+        // Allocate the values of the document from a single arena instead of
+        // one heap allocation each. The arena is released in one go once the
+        // last value of the document is destroyed.
+        bool use_arena;
+        // Make STRING and BINARY values views into the input instead of
+        // copies. The input must stay unchanged while any of them is alive:
+        // either keep it alive yourself or hand its owner to input_owner.
+        bool borrow_payloads;
+        // Shared owner of the input buffer, kept alive by every borrowed
+        // value.
+        std::shared_ptr<const void> input_owner;
+        // Count references to the values of the document with plain rather
+        // than atomic arithmetic. Copies and destruction of the result and of
+        // every value taken from it must then stay on one thread at a time.
+        bool single_thread;
+        // Limits on what one document may cost to parse. Each is checked
+        // before anything is allocated for the value it bounds, and a
+        // document that exceeds one fails with "exceeded parse limit.".
+        // Deepest level a value may be nested at; the top-level value is at 0.
+        int max_depth;
+        // Most elements in one array or key/value pairs in one object.
+        uint32_t max_elements;
+        // Longest STRING, BINARY or EXTENSION payload, in bytes.
+        uint32_t max_payload;
+        // Most values in the document, counting arrays, objects and keys.
+        size_t max_nodes;
+        // Most bytes of input the document may span.
+        size_t max_bytes;
+        // Codecs for the extension types to decode into native values while
+        // parsing. The registry must outlive the parse; the codecs, every
+        // value they decode.
+        const MsgPackExtensionRegistry * extensions;
+
+        ParseOptions()
+            : use_arena(false), borrow_payloads(false), single_thread(false), max_depth(200),
+              max_elements(std::numeric_limits<uint32_t>::max()),
+              max_payload(std::numeric_limits<uint32_t>::max()),
+              max_nodes(std::numeric_limits<size_t>::max()),
+              max_bytes(std::numeric_limits<size_t>::max()), extensions(nullptr) {}
+    };
+    static MsgPack parse(const char * in, size_t len, std::string & err, const ParseOptions & options);
+    static MsgPack parse(const uint8_t * in, size_t len, std::string & err, const ParseOptions & options);
+    // Parse from a stream with options. Payload lengths and max_bytes are
+    // checked before anything is read; borrow_payloads, input_owner and
+    // use_arena do not apply.
+    static MsgPack parse(std::istream& is, std::string &err, const ParseOptions & options);
+    // Parse only the values at the given key paths, skipping every other
+    // subtree without decoding it. A path step matches an object value by its
+    // string key; "*" matches every element of an array and every value of an
+    // object. The result keeps the shape of the input: objects hold only the
+    // keys that lead to a match, arrays reached through "*" keep every
+    // position, with MsgPack() where an element does not match. A value at
+    // the end of a path is parsed whole. Where a key matches both a named step
+    // and "*", both are followed and what they select is merged. If parse
+    // fails, return MsgPack() and assign an error message to err.
+    typedef std::vector<std::string> key_path;
+    static MsgPack parse_projected(const char * in, size_t len, const std::vector<key_path> & paths, std::string & err);
+    static MsgPack parse_projected(const uint8_t * in, size_t len, const std::vector<key_path> & paths, std::string & err);
+    // Parse only the given key paths with options. The limits apply to the
+    // values built, not to the subtrees skipped.
+    static MsgPack parse_projected(const char * in, size_t len, const std::vector<key_path> & paths, std::string & err,
+                                   const ParseOptions & options);
+    static MsgPack parse_projected(const uint8_t * in, size_t len, const std::vector<key_path> & paths, std::string & err,
+                                   const ParseOptions & options);
+    // Parse without building a MsgPack, reporting each value to visitor as it
+    // is read. Return false and assign an error message to err if the parse
+    // fails or the visitor stops it. Of options, max_depth applies.
+    static bool parse(const char * in, size_t len, MsgPackVisitor & visitor, std::string & err);
+    static bool parse(const uint8_t * in, size_t len, MsgPackVisitor & visitor, std::string & err);
+    static bool parse(const char * in, size_t len, MsgPackVisitor & visitor, std::string & err,
+                      const ParseOptions & options);
+    static bool parse(const uint8_t * in, size_t len, MsgPackVisitor & visitor, std::string & err,
+                      const ParseOptions & options);
     // Parse multiple objects, concatenated or separated by whitespace
     static std::vector<MsgPack> parse_multi(
         const std::string & in,
@@ -220,6 +365,31 @@ public:
         return parse_multi(in, parser_stop_pos, err);
     }
 
+    // Parse multiple objects like parse_multi(), decoding them on up to
+    // threads threads (0 picks std::thread::hardware_concurrency()). A
+    // skip-only pass finds the value boundaries first; runs of whole values
+    // are then decoded in parallel. The values, parser_stop_pos and err come
+    // out exactly as from the serial parse_multi(). Of options, max_depth and
+    // the limits apply, to each value separately.
+    static std::vector<MsgPack> parse_multi(
+        const std::string & in,
+        std::string::size_type & parser_stop_pos,
+        std::string & err,
+        unsigned threads);
+    static std::vector<MsgPack> parse_multi(
+        const char * in,
+        size_t len,
+        size_t & parser_stop_pos,
+        std::string & err,
+        unsigned threads);
+    static std::vector<MsgPack> parse_multi(
+        const char * in,
+        size_t len,
+        size_t & parser_stop_pos,
+        std::string & err,
+        unsigned threads,
+        const ParseOptions & options);
+
     bool operator== (const MsgPack &rhs) const;
     bool operator<  (const MsgPack &rhs) const;
     bool operator!= (const MsgPack &rhs) const { return !(*this == rhs); }
@@ -235,8 +405,1121 @@ public:
     typedef std::initializer_list<std::pair<std::string, Type>> shape;
     bool has_shape(const shape & types, std::string & err) const;
 
+    MsgPack(const MsgPack &other) noexcept;
+    MsgPack(MsgPack &&other) noexcept;
+    MsgPack &operator=(const MsgPack &other) noexcept;
+    MsgPack &operator=(MsgPack &&other) noexcept;
+    ~MsgPack();
+
+private:
+    friend class MsgPackValue;
+    // Take over the reference the caller holds on value.
+    explicit MsgPack(MsgPackValue *value) noexcept;
+    // EXTENSION holding a copy of the native value at value.
+    MsgPack(const MsgPackExtensionCodec & codec, const void * value);
+    // Return the native value if this extension holds one of codec.
+    const void * native_value(const MsgPackExtensionCodec & codec) const;
+
+    // Return true if the value is stored in the handle itself rather than in
+    // a heap allocated MsgPackValue.
+    bool is_inline() const { return m_type < STRING; }
+    template <typename T> T number_as() const;
+
+    // NUL, BOOL and the number types are held inline; every other type is
+    // held through m_ptr, which owns one reference counted by the value itself.
+    Type m_type;
+    union {
+        bool m_bool;
+        int64_t m_int;
+        uint64_t m_uint;
+        float m_float32;
+        double m_float64;
+        MsgPackValue *m_ptr;
+    };
+};
+
+/* MsgPack::object
+ *
+ * Map from MsgPack to MsgPack with the interface and ordering of
+ * std::map<MsgPack, MsgPack>. The pairs live in blocks that are never moved,
+ * so references and pointers to a pair stay valid until it is erased, as
+ * with std::map, and a vector of pointers to them sorted by key serves
+ * lookups and iteration. A map built from a range or a vector of pairs holds
+ * them in a single block. Unlike std::map, insert() and erase() shift the
+ * pointers after the position they change, which invalidates iterators, and
+ * build large maps from a range or a vector of pairs rather than one key at
+ * a time.
+ */
+class MsgPack::object final {
+public:
+    typedef MsgPack key_type;
+    typedef MsgPack mapped_type;
+    typedef std::pair<const MsgPack, MsgPack> value_type;
+    typedef std::vector<value_type *>::size_type size_type;
+    // Random access iterator over the pairs in key order.
+    template <class Value>
+    class basic_iterator {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef typename std::remove_const<Value>::type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Value & reference;
+        typedef Value * pointer;
+
+        basic_iterator() : m_pos(nullptr) {}
+        // iterator converts to const_iterator.
+        template <class Other, typename std::enable_if<
+            std::is_const<Value>::value && !std::is_const<Other>::value,
+                int>::type = 0>
+        basic_iterator(const basic_iterator<Other> &other) : m_pos(other.m_pos) {}
+
+        reference operator*() const { return **m_pos; }
+        pointer operator->() const { return *m_pos; }
+        reference operator[](difference_type n) const { return *m_pos[n]; }
+
+        basic_iterator &operator++() { ++m_pos; return *this; }
+        basic_iterator &operator--() { --m_pos; return *this; }
+        basic_iterator operator++(int) { basic_iterator ret = *this; ++m_pos; return ret; }
+        basic_iterator operator--(int) { basic_iterator ret = *this; --m_pos; return ret; }
+        basic_iterator &operator+=(difference_type n) { m_pos += n; return *this; }
+        basic_iterator &operator-=(difference_type n) { m_pos -= n; return *this; }
+        friend basic_iterator operator+(basic_iterator it, difference_type n) { return it += n; }
+        friend basic_iterator operator+(difference_type n, basic_iterator it) { return it += n; }
+        friend basic_iterator operator-(basic_iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const basic_iterator &a, const basic_iterator &b) { return a.m_pos - b.m_pos; }
+
+        friend bool operator==(const basic_iterator &a, const basic_iterator &b) { return a.m_pos == b.m_pos; }
+        friend bool operator!=(const basic_iterator &a, const basic_iterator &b) { return a.m_pos != b.m_pos; }
+        friend bool operator<(const basic_iterator &a, const basic_iterator &b) { return a.m_pos < b.m_pos; }
+        friend bool operator>(const basic_iterator &a, const basic_iterator &b) { return b.m_pos < a.m_pos; }
+        friend bool operator<=(const basic_iterator &a, const basic_iterator &b) { return !(b.m_pos < a.m_pos); }
+        friend bool operator>=(const basic_iterator &a, const basic_iterator &b) { return !(a.m_pos < b.m_pos); }
+
+    private:
+        friend class object;
+        template <class Other> friend class basic_iterator;
+
+        explicit basic_iterator(object::value_type * const *pos) : m_pos(pos) {}
+
+        object::value_type * const *m_pos;
+    };
+    typedef basic_iterator<value_type> iterator;
+    typedef basic_iterator<const value_type> const_iterator;
+
+    object() {}
+    object(std::initializer_list<value_type> items)
+        : object(std::vector<std::pair<MsgPack, MsgPack>>(items.begin(), items.end())) {}
+    template <class It>
+    object(It first, It last) : object(std::vector<std::pair<MsgPack, MsgPack>>(first, last)) {}
+    // Take pairs in any order. As with std::map, the first of several equal
+    // keys is kept.
+    explicit object(std::vector<std::pair<MsgPack, MsgPack>> &&items);
+    object(const object &other);
+    object(object &&other) noexcept { swap(other); }
+    object &operator=(object other) noexcept { swap(other); return *this; }
+    ~object() { clear(); }
+    void swap(object &other) noexcept;
+
+    iterator begin()              { return iterator(m_index.data()); }
+    iterator end()                { return iterator(m_index.data() + m_index.size()); }
+    const_iterator begin() const  { return const_iterator(m_index.data()); }
+    const_iterator end() const    { return const_iterator(m_index.data() + m_index.size()); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const   { return end(); }
+
+    bool empty() const { return m_index.empty(); }
+    size_type size() const { return m_index.size(); }
+    void clear() noexcept;
+
+    iterator lower_bound(const MsgPack &key);
+    const_iterator lower_bound(const MsgPack &key) const;
+    iterator find(const MsgPack &key);
+    const_iterator find(const MsgPack &key) const;
+    // Find a string key without constructing a MsgPack for it.
+    iterator find(const char *key, size_t len);
+    const_iterator find(const char *key, size_t len) const;
+    template <class T, typename std::enable_if<
+        std::is_same<T, const char *>::value || std::is_same<T, char *>::value,
+            int>::type = 0>
+    iterator find(T key) { return find(key, std::char_traits<char>::length(key)); }
+    template <class T, typename std::enable_if<
+        std::is_same<T, const char *>::value || std::is_same<T, char *>::value,
+            int>::type = 0>
+    const_iterator find(T key) const { return find(key, std::char_traits<char>::length(key)); }
+    iterator find(const std::string &key) { return find(key.data(), key.size()); }
+    const_iterator find(const std::string &key) const { return find(key.data(), key.size()); }
+#if __cplusplus >= 201703L
+    iterator find(std::string_view key) { return find(key.data(), key.size()); }
+    const_iterator find(std::string_view key) const { return find(key.data(), key.size()); }
+#endif
+    size_type count(const MsgPack &key) const { return find(key) == end() ? 0 : 1; }
+    size_type count(const char *key, size_t len) const { return find(key, len) == end() ? 0 : 1; }
+    template <class T, typename std::enable_if<
+        std::is_same<T, const char *>::value || std::is_same<T, char *>::value,
+            int>::type = 0>
+    size_type count(T key) const { return count(key, std::char_traits<char>::length(key)); }
+    size_type count(const std::string &key) const { return count(key.data(), key.size()); }
+#if __cplusplus >= 201703L
+    size_type count(std::string_view key) const { return count(key.data(), key.size()); }
+#endif
+
+    // Insert value unless its key is already present.
+    std::pair<iterator, bool> insert(const value_type &value);
+    std::pair<iterator, bool> insert(value_type &&value);
+    // Return the value for key, inserting MsgPack() if it is not present.
+    MsgPack &operator[](const MsgPack &key);
+    MsgPack &operator[](MsgPack &&key);
+    iterator erase(const_iterator pos);
+    size_type erase(const MsgPack &key);
+
+    bool operator== (const object &rhs) const;
+    bool operator<  (const object &rhs) const;
+    bool operator!= (const object &rhs) const { return !(*this == rhs); }
+
+private:
+    // Slots for capacity pairs, of which the first used have been handed out.
+    struct Block {
+        value_type *slots;
+        size_t used;
+        size_t capacity;
+    };
+
+    // Return uninitialized room for one more pair, with room reserved in
+    // m_index to insert it without throwing.
+    value_type *new_slot();
+    // Destroy the pair at slot and keep the slot for reuse.
+    void free_slot(value_type *slot) noexcept;
+    void add_block(size_t capacity);
+    // Construct a pair from args at pos, which must be where its key sorts.
+    template <class... Args>
+    iterator emplace_at(const_iterator pos, Args &&... args);
+
+    // The pairs in key order.
+    std::vector<value_type *> m_index;
+    std::vector<Block> m_blocks;
+    // Slots of erased pairs.
+    std::vector<value_type *> m_free;
+};
+
+/* MsgPackExtensionCodec
+ *
+ * Conversion between the payload of one extension type and a native value,
+ * so that values of a registered type are decoded once, while parsing, and
+ * kept inside the MsgPack instead of as a copy of their payload. Native
+ * values are copied as plain bytes, at most max_value_size of them.
+ * MsgPackNativeCodec<T> implements it for a type T.
+ */
+class MsgPackExtensionCodec {
+public:
+    enum { max_value_size = 16, max_value_align = 8, max_payload_size = 32 };
+
+    // Throw std::invalid_argument if value_size is over max_value_size.
+    MsgPackExtensionCodec(int8_t type, size_t value_size);
+    virtual ~MsgPackExtensionCodec() {}
+
+    int8_t type() const { return m_type; }
+    size_t value_size() const { return m_value_size; }
+
+    // Decode a payload into value, which has room for max_value_size bytes.
+    // Return false if the payload is not valid; parse() then keeps it as a
+    // plain extension.
+    virtual bool decode(const uint8_t * data, size_t len, void * value) const = 0;
+    // Encode value into out, which has room for max_payload_size bytes, and
+    // return the payload length.
+    virtual size_t encode(const void * value, uint8_t * out) const = 0;
+
+private:
+    int8_t const m_type;
+    size_t const m_value_size;
+};
+
+/* MsgPackExtensionTraits
+ *
+ * Mapping between a native type and its extension type. Specialize it for
+ * each application type:
+ *
+ *     template <> struct MsgPackExtensionTraits<Uuid> {
+ *         static int8_t type() { return 2; }
+ *         // Return false if the payload is not a valid Uuid.
+ *         static bool decode(const uint8_t * data, size_t len, Uuid & value);
+ *         // Write at most MsgPackExtensionCodec::max_payload_size bytes to
+ *         // out and return how many.
+ *         static size_t encode(const Uuid & value, uint8_t * out);
+ *     };
+ *
+ * The type must be trivially copyable and fit in
+ * MsgPackExtensionCodec::max_value_size bytes.
+ */
+template <typename T>
+struct MsgPackExtensionTraits;
+
+template <>
+struct MsgPackExtensionTraits<MsgPack::timestamp> {
+    static int8_t type() { return -1; }
+    static bool decode(const uint8_t * data, size_t len, MsgPack::timestamp & value) {
+        return MsgPack::timestamp::decode(data, len, value);
+    }
+    static size_t encode(const MsgPack::timestamp & value, uint8_t * out) { return value.encode(out); }
+};
+
+/* MsgPackNativeCodec
+ *
+ * MsgPackExtensionCodec of a type T described by MsgPackExtensionTraits<T>.
+ * instance() is the one codec of T, which extension_value<T>() looks for.
+ */
+template <typename T>
+class MsgPackNativeCodec final : public MsgPackExtensionCodec {
+    static_assert(sizeof(T) <= max_value_size, "native extension values take at most 16 bytes");
+    static_assert(alignof(T) <= max_value_align, "native extension values are aligned to at most 8 bytes");
+    static_assert(std::is_trivially_copyable<T>::value, "native extension values are copied as bytes");
+
+public:
+    static const MsgPackNativeCodec & instance() {
+        static const MsgPackNativeCodec codec;
+        return codec;
+    }
+
+    bool decode(const uint8_t * data, size_t len, void * value) const override {
+        return MsgPackExtensionTraits<T>::decode(data, len, *static_cast<T *>(value));
+    }
+    size_t encode(const void * value, uint8_t * out) const override {
+        return MsgPackExtensionTraits<T>::encode(*static_cast<const T *>(value), out);
+    }
+
+private:
+    MsgPackNativeCodec() : MsgPackExtensionCodec(MsgPackExtensionTraits<T>::type(), sizeof(T)) {}
+};
+
+/* MsgPackExtensionRegistry
+ *
+ * Table of the codecs parse() decodes extensions with, indexed by extension
+ * type. Pass it through ParseOptions::extensions.
+ */
+class MsgPackExtensionRegistry final {
+public:
+    MsgPackExtensionRegistry() : m_codecs() {}
+
+    // Decode extensions of codec.type() with codec, replacing any codec
+    // added for that type before.
+    void add(const MsgPackExtensionCodec & codec) { m_codecs[static_cast<uint8_t>(codec.type())] = &codec; }
+    template <typename T> void add() { add(MsgPackNativeCodec<T>::instance()); }
+    // Return the codec for type, or nullptr if there is none.
+    const MsgPackExtensionCodec * find(int8_t type) const { return m_codecs[static_cast<uint8_t>(type)]; }
+
+private:
+    const MsgPackExtensionCodec * m_codecs[256];
+};
+
+template <class T>
+MsgPack MsgPack::make_extension(const T & value) {
+    return MsgPack(MsgPackNativeCodec<T>::instance(), &value);
+}
+
+template <class T>
+const T * MsgPack::extension_value() const {
+    return static_cast<const T *>(native_value(MsgPackNativeCodec<T>::instance()));
+}
+
+/* MsgPackToken
+ *
+ * One item read by MsgPackReader: a scalar, a string, binary or extension
+ * payload, or the header of an array or map. The elements of an array or map
+ * are read as the tokens that follow it.
+ */
+struct MsgPackToken {
+    // NUL, BOOL, one of the number types, STRING, BINARY, ARRAY, OBJECT or
+    // EXTENSION.
+    MsgPack::Type type;
+    // Number of elements for ARRAY, number of key/value pairs for OBJECT and
+    // payload size in bytes for STRING, BINARY and EXTENSION.
+    uint32_t length;
+    // Extension type code for EXTENSION.
+    int8_t ext_type;
+    // Scalar value. INT* types use int_value and UINT* types use uint_value.
+    union {
+        bool bool_value;
+        int64_t int_value;
+        uint64_t uint_value;
+        float float32_value;
+        double float64_value;
+    };
+    // Payload of STRING, BINARY and EXTENSION, pointing into the input.
+    const uint8_t * data;
+
+    const char * string_data() const { return reinterpret_cast<const char *>(data); }
+};
+
+/* MsgPackReader
+ *
+ * Pull parser over a memory buffer. next() returns one token at a time and
+ * skip() steps over a whole value, including every element of an array or
+ * map, without decoding it. Nothing is copied or allocated; the buffer must
+ * outlive the reader and the tokens it returns.
+ */
+class MsgPackReader final {
+public:
+    MsgPackReader(const uint8_t * data, size_t size);
+    MsgPackReader(const char * data, size_t size);
+
+    // Read the next token. Return false at the end of the input or if the
+    // input is malformed; error() tells which.
+    bool next(MsgPackToken & token);
+    // Skip the next value. Return false under the same conditions as next().
+    bool skip();
+
+    // Return true if all input has been consumed.
+    bool at_end() const { return m_pos == m_end; }
+    // Return the number of bytes left to read.
+    size_t remaining() const { return static_cast<size_t>(m_end - m_pos); }
+    // Return the current read position.
+    const uint8_t * position() const { return m_pos; }
+    // Return nullptr if no read has failed, or a description of the failure.
+    const char * error() const;
+
+    // Read n numbers into out, converting each as MsgPackCodec<T>::read()
+    // does; runs of fixints or of same-width floats are decoded in bulk, the
+    // floats byte-swapped 16 bytes at a time where SSE2 is available.
+    // Return false under the same conditions as next() or if a value does
+    // not convert.
+    bool read_numbers(float * out, size_t n);
+    bool read_numbers(double * out, size_t n);
+    bool read_numbers(int8_t * out, size_t n);
+    bool read_numbers(int16_t * out, size_t n);
+    bool read_numbers(int32_t * out, size_t n);
+    bool read_numbers(int64_t * out, size_t n);
+    bool read_numbers(uint8_t * out, size_t n);
+    bool read_numbers(uint16_t * out, size_t n);
+    bool read_numbers(uint32_t * out, size_t n);
+    bool read_numbers(uint64_t * out, size_t n);
+
+private:
+    template <typename T> bool read_number_array(T * out, size_t n);
+
+    const uint8_t * m_pos;
+    const uint8_t * m_end;
+    bool m_eof;
+    bool m_fail;
+};
+
+/* MsgPackWriter
+ *
+ * Encoder that appends values straight to a buffer without building a
+ * MsgPack first. Each call picks the smallest encoding for its value, as
+ * dump() does. begin_array(n) and begin_map(n) only write a header: the
+ * caller then writes exactly n elements, or n keys each followed by its
+ * value.
+ */
+class MsgPackWriter final {
+public:
+    explicit MsgPackWriter(std::string & out);
+    explicit MsgPackWriter(MsgPack::binary & out);
+
+    void begin_array(size_t n);
+    void begin_map(size_t n);
+
+    void write_nil();
+    void write(bool value);
+    void write(float value);
+    void write(double value);
+    void write(int8_t value);
+    void write(int16_t value);
+    void write(int32_t value);
+    void write(int64_t value);
+    void write(uint8_t value);
+    void write(uint16_t value);
+    void write(uint32_t value);
+    void write(uint64_t value);
+    // Write a whole value, e.g. one that was parsed earlier.
+    void write(const MsgPack & value);
+    // Strings go through write_str(); without this a C string would be
+    // written as a bool.
+    void write(const char * value) = delete;
+
+    void write_str(const char * data, size_t len);
+    void write_str(const std::string & value);
+    void write_bin(const uint8_t * data, size_t len);
+    void write_ext(int8_t type, const uint8_t * data, size_t len);
+    // Write a timestamp extension in its smallest form, without allocating.
+    void write(const MsgPack::timestamp & value);
+
+    // Write an ARRAY of n numbers, encoding each as write() would, in one
+    // pass over data. Where SSE2 is available, blocks of fixints are narrowed
+    // and floats byte-swapped 16 bytes at a time.
+    void write_array(const float * data, size_t n);
+    void write_array(const double * data, size_t n);
+    void write_array(const int8_t * data, size_t n);
+    void write_array(const int16_t * data, size_t n);
+    void write_array(const int32_t * data, size_t n);
+    void write_array(const int64_t * data, size_t n);
+    void write_array(const uint8_t * data, size_t n);
+    void write_array(const uint16_t * data, size_t n);
+    void write_array(const uint32_t * data, size_t n);
+    void write_array(const uint64_t * data, size_t n);
+
+    // Return the size of the buffer in bytes.
+    size_t size() const;
+
+private:
+    template <typename T> void put(const T & value);
+    template <typename T> void put_array(const T * data, size_t n);
+
+    std::string * m_string;
+    MsgPack::binary * m_binary;
+};
+
+/* MsgPackCodec
+ *
+ * Compile-time mapping between a C++ type and its encoding, used by encode()
+ * and decode() to convert values straight to and from bytes without building
+ * a MsgPack. It is defined for bool, the integer and floating point types,
+ * std::string, MsgPack, MsgPack::timestamp, std::vector, std::deque, std::map,
+ * std::pair, std::tuple and every struct that lists its fields with
+ * MSGPACK11_FIELDS.
+ * MsgPack::binary is encoded as BINARY, other vectors and deques as ARRAY,
+ * maps as OBJECT, and pairs, tuples and structs as an ARRAY of their fields in
+ * order. Specialize it to support further types:
+ *
+ *     template <> struct MsgPackCodec<Point> {
+ *         static void write(MsgPackWriter & writer, const Point & value);
+ *         // Return false if the next value has the wrong type or the input
+ *         // is malformed.
+ *         static bool read(MsgPackReader & reader, Point & value);
+ *     };
+ *
+ * Decoding an integer fails if the value does not fit the target type.
+ */
+template <typename T, typename Enable = void>
+struct MsgPackCodec;
+
+/* MSGPACK11_FIELDS(fields...)
+ *
+ * Make a struct encodable by listing its fields, e.g.
+ *
+ *     struct Point {
+ *         int x, y;
+ *         std::string label;
+ *         MSGPACK11_FIELDS(x, y, label)
+ *     };
+ *
+ * Place it after the declarations of the fields it names.
+ */
+#define MSGPACK11_FIELDS(...) \
+    auto msgpack_fields() -> decltype(std::tie(__VA_ARGS__)) { return std::tie(__VA_ARGS__); } \
+    auto msgpack_fields() const -> decltype(std::tie(__VA_ARGS__)) { return std::tie(__VA_ARGS__); }
+
+namespace detail {
+    template <typename T>
+    using codec_type = MsgPackCodec<typename std::decay<T>::type>;
+
+    template <typename T, typename = void>
+    struct has_msgpack_fields : std::false_type {};
+    template <typename T>
+    struct has_msgpack_fields<T, decltype(void(std::declval<T &>().msgpack_fields()))> : std::true_type {};
+
+    // Numbers that MsgPackWriter::write_array() and
+    // MsgPackReader::read_numbers() handle.
+    template <typename T>
+    struct is_bulk_number : std::integral_constant<bool,
+        std::is_same<T, float>::value || std::is_same<T, double>::value ||
+        std::is_same<T, int8_t>::value || std::is_same<T, int16_t>::value ||
+        std::is_same<T, int32_t>::value || std::is_same<T, int64_t>::value ||
+        std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value ||
+        std::is_same<T, uint32_t>::value || std::is_same<T, uint64_t>::value> {};
+
+    inline bool is_uint_token(const MsgPackToken & token) {
+        return token.type == MsgPack::UINT8 || token.type == MsgPack::UINT16 ||
+               token.type == MsgPack::UINT32 || token.type == MsgPack::UINT64;
+    }
+
+    // Read the header of an ARRAY or OBJECT with exactly length elements.
+    inline bool read_header(MsgPackReader & reader, MsgPack::Type type, uint32_t & length) {
+        MsgPackToken token;
+        if (!reader.next(token) || token.type != type) {
+            return false;
+        }
+        length = token.length;
+        return true;
+    }
+
+    template <size_t I, size_t N>
+    struct tuple_codec {
+        template <typename Tuple>
+        static void write(MsgPackWriter & writer, const Tuple & value) {
+            codec_type<typename std::tuple_element<I, Tuple>::type>::write(writer, std::get<I>(value));
+            tuple_codec<I + 1, N>::write(writer, value);
+        }
+        template <typename Tuple>
+        static bool read(MsgPackReader & reader, Tuple & value) {
+            typedef typename std::tuple_element<I, Tuple>::type element;
+            return codec_type<element>::read(reader, std::get<I>(value)) &&
+                   tuple_codec<I + 1, N>::read(reader, value);
+        }
+    };
+
+    template <size_t N>
+    struct tuple_codec<N, N> {
+        template <typename Tuple>
+        static void write(MsgPackWriter &, const Tuple &) {}
+        template <typename Tuple>
+        static bool read(MsgPackReader &, Tuple &) { return true; }
+    };
+
+    // Encode a tuple, or a tuple of references to the fields of a struct, as
+    // an ARRAY.
+    template <typename Tuple>
+    void write_tuple(MsgPackWriter & writer, const Tuple & value) {
+        size_t const n = std::tuple_size<Tuple>::value;
+        writer.begin_array(n);
+        tuple_codec<0, n>::write(writer, value);
+    }
+
+    template <typename Tuple>
+    bool read_tuple(MsgPackReader & reader, Tuple && value) {
+        typedef typename std::decay<Tuple>::type tuple;
+        size_t const n = std::tuple_size<tuple>::value;
+        uint32_t length;
+        return read_header(reader, MsgPack::ARRAY, length) && length == n &&
+               tuple_codec<0, n>::read(reader, value);
+    }
+
+    // Decode the elements of an ARRAY, appending each to value.
+    template <typename Sequence>
+    bool read_sequence(MsgPackReader & reader, Sequence & value) {
+        uint32_t length;
+        if (!read_header(reader, MsgPack::ARRAY, length)) {
+            return false;
+        }
+        value.clear();
+        for (uint32_t i = 0; i < length; ++i) {
+            typename Sequence::value_type element;
+            if (!MsgPackCodec<typename Sequence::value_type>::read(reader, element)) {
+                return false;
+            }
+            value.push_back(std::move(element));
+        }
+        return true;
+    }
+}
+
+template <>
+struct MsgPackCodec<bool> {
+    static void write(MsgPackWriter & writer, bool value) { writer.write(value); }
+    static bool read(MsgPackReader & reader, bool & value) {
+        MsgPackToken token;
+        if (!reader.next(token) || token.type != MsgPack::BOOL) {
+            return false;
+        }
+        value = token.bool_value;
+        return true;
+    }
+};
+
+template <typename T>
+struct MsgPackCodec<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+    static void write(MsgPackWriter & writer, T value) {
+        if (std::is_signed<T>::value) {
+            writer.write(static_cast<int64_t>(value));
+        } else {
+            writer.write(static_cast<uint64_t>(value));
+        }
+    }
+    static bool read(MsgPackReader & reader, T & value) {
+        typedef std::numeric_limits<T> limits;
+        MsgPackToken token;
+        if (!reader.next(token) || (token.type & MsgPack::INT) != MsgPack::INT) {
+            return false;
+        }
+        if (detail::is_uint_token(token) || 0 <= token.int_value) {
+            uint64_t const v = detail::is_uint_token(token) ? token.uint_value : static_cast<uint64_t>(token.int_value);
+            if (static_cast<uint64_t>(limits::max()) < v) {
+                return false;
+            }
+            value = static_cast<T>(v);
+        } else {
+            if (!limits::is_signed || token.int_value < static_cast<int64_t>(limits::min())) {
+                return false;
+            }
+            value = static_cast<T>(token.int_value);
+        }
+        return true;
+    }
+};
+
+template <typename T>
+struct MsgPackCodec<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    static void write(MsgPackWriter & writer, T value) {
+        // FLOAT32 for float, FLOAT64 for double and long double.
+        writer.write(static_cast<typename std::conditional<std::is_same<T, float>::value, float, double>::type>(value));
+    }
+    // Accept any number, so that e.g. a double field decodes a value that was
+    // written as an integer.
+    static bool read(MsgPackReader & reader, T & value) {
+        MsgPackToken token;
+        if (!reader.next(token) || !(token.type & MsgPack::NUMBER)) {
+            return false;
+        }
+        if (token.type == MsgPack::FLOAT32) {
+            value = static_cast<T>(token.float32_value);
+        } else if (token.type == MsgPack::FLOAT64) {
+            value = static_cast<T>(token.float64_value);
+        } else if (detail::is_uint_token(token)) {
+            value = static_cast<T>(token.uint_value);
+        } else {
+            value = static_cast<T>(token.int_value);
+        }
+        return true;
+    }
+};
+
+template <>
+struct MsgPackCodec<std::string> {
+    static void write(MsgPackWriter & writer, const std::string & value) { writer.write_str(value); }
+    static bool read(MsgPackReader & reader, std::string & value) {
+        MsgPackToken token;
+        if (!reader.next(token) || token.type != MsgPack::STRING) {
+            return false;
+        }
+        value.assign(token.string_data(), token.length);
+        return true;
+    }
+};
+
+template <>
+struct MsgPackCodec<MsgPack::binary> {
+    static void write(MsgPackWriter & writer, const MsgPack::binary & value) {
+        writer.write_bin(value.data(), value.size());
+    }
+    static bool read(MsgPackReader & reader, MsgPack::binary & value) {
+        MsgPackToken token;
+        if (!reader.next(token) || token.type != MsgPack::BINARY) {
+            return false;
+        }
+        value.assign(token.data, token.data + token.length);
+        return true;
+    }
+};
+
+template <>
+struct MsgPackCodec<MsgPack::timestamp> {
+    static void write(MsgPackWriter & writer, const MsgPack::timestamp & value) { writer.write(value); }
+    static bool read(MsgPackReader & reader, MsgPack::timestamp & value) {
+        MsgPackToken token;
+        return reader.next(token) && token.type == MsgPack::EXTENSION && token.ext_type == -1 &&
+               MsgPack::timestamp::decode(token.data, token.length, value);
+    }
+};
+
+// A MsgPack field holds any value, e.g. a part of the schema that varies.
+template <>
+struct MsgPackCodec<MsgPack> {
+    static void write(MsgPackWriter & writer, const MsgPack & value) { writer.write(value); }
+    static bool read(MsgPackReader & reader, MsgPack & value) {
+        const uint8_t * const begin = reader.position();
+        if (!reader.skip()) {
+            return false;
+        }
+        std::string err;
+        value = MsgPack::parse(begin, static_cast<size_t>(reader.position() - begin), err);
+        return err.empty();
+    }
+};
+
+template <typename T, typename Allocator>
+struct MsgPackCodec<std::vector<T, Allocator>, typename std::enable_if<!detail::is_bulk_number<T>::value>::type> {
+    static void write(MsgPackWriter & writer, const std::vector<T, Allocator> & value) {
+        writer.begin_array(value.size());
+        for (const T & element : value) {
+            MsgPackCodec<T>::write(writer, element);
+        }
+    }
+    static bool read(MsgPackReader & reader, std::vector<T, Allocator> & value) {
+        return detail::read_sequence(reader, value);
+    }
+};
+
+// Vectors of fixed-width numbers are converted in bulk.
+template <typename T, typename Allocator>
+struct MsgPackCodec<std::vector<T, Allocator>, typename std::enable_if<detail::is_bulk_number<T>::value>::type> {
+    static void write(MsgPackWriter & writer, const std::vector<T, Allocator> & value) {
+        writer.write_array(value.data(), value.size());
+    }
+    static bool read(MsgPackReader & reader, std::vector<T, Allocator> & value) {
+        uint32_t length;
+        if (!detail::read_header(reader, MsgPack::ARRAY, length)) {
+            return false;
+        }
+        // Every element takes at least one byte, so growing by at most the
+        // bytes left keeps a bogus length from allocating more than the input
+        // could hold.
+        value.clear();
+        while (value.size() < length) {
+            size_t const done = value.size();
+            size_t const count = std::min<size_t>(length - done, std::max<size_t>(reader.remaining(), 1));
+            value.resize(done + count);
+            if (!reader.read_numbers(value.data() + done, count)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+template <typename T, typename Allocator>
+struct MsgPackCodec<std::deque<T, Allocator>> {
+    static void write(MsgPackWriter & writer, const std::deque<T, Allocator> & value) {
+        writer.begin_array(value.size());
+        for (const T & element : value) {
+            MsgPackCodec<T>::write(writer, element);
+        }
+    }
+    static bool read(MsgPackReader & reader, std::deque<T, Allocator> & value) {
+        return detail::read_sequence(reader, value);
+    }
+};
+
+// Where the input repeats a key, the first occurrence wins, as in
+// MsgPack::object.
+template <typename K, typename V, typename Compare, typename Allocator>
+struct MsgPackCodec<std::map<K, V, Compare, Allocator>> {
+    typedef std::map<K, V, Compare, Allocator> map;
+
+    static void write(MsgPackWriter & writer, const map & value) {
+        writer.begin_map(value.size());
+        for (const typename map::value_type & item : value) {
+            MsgPackCodec<K>::write(writer, item.first);
+            MsgPackCodec<V>::write(writer, item.second);
+        }
+    }
+    static bool read(MsgPackReader & reader, map & value) {
+        uint32_t length;
+        if (!detail::read_header(reader, MsgPack::OBJECT, length)) {
+            return false;
+        }
+        value.clear();
+        for (uint32_t i = 0; i < length; ++i) {
+            K key;
+            V mapped;
+            if (!MsgPackCodec<K>::read(reader, key) || !MsgPackCodec<V>::read(reader, mapped)) {
+                return false;
+            }
+            value.emplace(std::move(key), std::move(mapped));
+        }
+        return true;
+    }
+};
+
+template <typename T1, typename T2>
+struct MsgPackCodec<std::pair<T1, T2>> {
+    static void write(MsgPackWriter & writer, const std::pair<T1, T2> & value) {
+        detail::write_tuple(writer, std::tie(value.first, value.second));
+    }
+    static bool read(MsgPackReader & reader, std::pair<T1, T2> & value) {
+        return detail::read_tuple(reader, std::tie(value.first, value.second));
+    }
+};
+
+template <typename... Ts>
+struct MsgPackCodec<std::tuple<Ts...>> {
+    static void write(MsgPackWriter & writer, const std::tuple<Ts...> & value) {
+        detail::write_tuple(writer, value);
+    }
+    static bool read(MsgPackReader & reader, std::tuple<Ts...> & value) {
+        return detail::read_tuple(reader, value);
+    }
+};
+
+template <typename T>
+struct MsgPackCodec<T, typename std::enable_if<detail::has_msgpack_fields<T>::value>::type> {
+    static void write(MsgPackWriter & writer, const T & value) {
+        detail::write_tuple(writer, value.msgpack_fields());
+    }
+    static bool read(MsgPackReader & reader, T & value) {
+        return detail::read_tuple(reader, value.msgpack_fields());
+    }
+};
+
+/* encode(value, out), decode(in, len, value, err)
+ *
+ * Replace out with the encoding of value, or decode the value at the start of
+ * in into value. decode() returns false and assigns an error message to err if
+ * the input is malformed or does not match the type of value; value may then
+ * be partly assigned.
+ */
+template <typename T>
+void encode(const T & value, std::string & out) {
+    out.clear();
+    MsgPackWriter writer(out);
+    MsgPackCodec<T>::write(writer, value);
+}
+
+template <typename T>
+void encode(const T & value, MsgPack::binary & out) {
+    out.clear();
+    MsgPackWriter writer(out);
+    MsgPackCodec<T>::write(writer, value);
+}
+
+template <typename T>
+std::string encode(const T & value) {
+    std::string out;
+    encode(value, out);
+    return out;
+}
+
+template <typename T>
+bool decode(const uint8_t * in, size_t len, T & value, std::string & err) {
+    MsgPackReader reader(in, len);
+    if (MsgPackCodec<T>::read(reader, value)) {
+        return true;
+    }
+    const char * const reader_error = reader.error();
+    err = (reader_error != nullptr) ? reader_error : "type mismatch.";
+    return false;
+}
+
+template <typename T>
+bool decode(const char * in, size_t len, T & value, std::string & err) {
+    return decode(reinterpret_cast<const uint8_t *>(in), len, value, err);
+}
+
+template <typename T>
+bool decode(const std::string & in, T & value, std::string & err) {
+    return decode(in.data(), in.size(), value, err);
+}
+
+/* MsgPackIncrementalParser
+ *
+ * Parser for input that arrives in pieces, e.g. from a socket. feed() accepts
+ * chunks of any size and keeps the state of a partially received value (open
+ * arrays and maps, and the bytes of an incomplete item) between calls, so no
+ * byte is parsed twice. Each completed top-level value is returned once by
+ * next(), in input order.
+ */
+class MsgPackIncrementalParser final {
+public:
+    MsgPackIncrementalParser()
+        : m_fail(false), m_exceeded(false), m_nodes(0), m_bytes(0), m_token_size(0) {}
+    // Parse with options; of them, max_depth and the limits apply, to each
+    // top-level value separately. A token whose header declares more than
+    // max_payload or max_bytes allow fails the input before any of it is
+    // buffered.
+    explicit MsgPackIncrementalParser(const MsgPack::ParseOptions & options)
+        : m_options(options), m_fail(false), m_exceeded(false), m_nodes(0), m_bytes(0), m_token_size(0) {}
+
+    // Consume a chunk of input. Return false if the input is malformed; the
+    // parser then rejects further input until reset().
+    bool feed(const uint8_t * data, size_t len);
+    bool feed(const char * data, size_t len);
+
+    // Move the next completed value into msgpack. Return false if there is
+    // none yet.
+    bool next(MsgPack & msgpack);
+
+    // Return true if the input so far is malformed.
+    bool failed() const { return m_fail; }
+    // Return true if the input failed for going over a limit of the options.
+    bool exceeded() const { return m_exceeded; }
+    // Return true if no value is partially received.
+    bool idle() const { return m_pending.empty() && m_stack.empty(); }
+    // Drop all state, including completed values not yet returned by next().
+    void reset();
+
 private:
-    std::shared_ptr<MsgPackValue> m_ptr;
+    struct Frame {
+        bool is_object;
+        uint64_t remaining;
+        MsgPack::array items;
+    };
+
+    size_t consume(const uint8_t * data, size_t len);
+    void push(MsgPack && value);
+
+    MsgPack::ParseOptions m_options;
+    MsgPack::binary m_pending;
+    std::vector<Frame> m_stack;
+    std::deque<MsgPack> m_ready;
+    bool m_fail;
+    bool m_exceeded;
+    // Values and bytes of the current top-level value so far.
+    size_t m_nodes;
+    size_t m_bytes;
+    // Size of the token held in m_pending once its header is in, 0 before.
+    size_t m_token_size;
+};
+
+/* validate()
+ *
+ * Check that data starts with one well-formed MsgPack value, without
+ * decoding it, and allocating only for values nested deeper than a few dozen
+ * levels. Used to frame, route or reject input before parsing it. It accepts
+ * exactly what parse() with the same options does; of them, max_depth and
+ * the limits apply.
+ */
+struct MsgPackValidation {
+    enum Status {
+        VALID,      // a complete value starts at data
+        INCOMPLETE, // the input ends inside the value
+        MALFORMED,  // invalid type byte, or nesting deeper than max_depth
+        EXCEEDED    // over one of the other limits of the options
+    };
+
+    Status status;
+    // Bytes taken by the value if VALID, otherwise the offset of the token
+    // where validation stopped.
+    size_t size;
+    // Number of values read, counting keys, values and containers.
+    size_t nodes;
+    // Deepest nesting seen, where a top-level value is at depth 1.
+    size_t max_depth;
+};
+
+MsgPackValidation validate(const uint8_t * data, size_t len);
+MsgPackValidation validate(const char * data, size_t len);
+MsgPackValidation validate(const uint8_t * data, size_t len, const MsgPack::ParseOptions & options);
+MsgPackValidation validate(const char * data, size_t len, const MsgPack::ParseOptions & options);
+
+class MsgPackDocument;
+
+/* MsgPackElement
+ *
+ * Read-only view of one value of a MsgPackDocument. Scalars are decoded from
+ * the input each time they are read, and lookups walk the document's tape
+ * without building MsgPack values. Looking up a missing index or key gives an
+ * element of type NUL. Elements are only valid while their document and its
+ * input are.
+ */
+class MsgPackElement final {
+public:
+    MsgPackElement() : m_doc(nullptr), m_index(0) {}
+
+    MsgPack::Type type() const;
+
+    bool is_null()      const { return type() == MsgPack::NUL; }
+    bool is_bool()      const { return type() == MsgPack::BOOL; }
+    bool is_number()    const { return type() & MsgPack::NUMBER; }
+    bool is_int()       const { return (type() & MsgPack::INT) == MsgPack::INT; }
+    bool is_string()    const { return type() == MsgPack::STRING; }
+    bool is_binary()    const { return type() == MsgPack::BINARY; }
+    bool is_array()     const { return type() == MsgPack::ARRAY; }
+    bool is_object()    const { return type() == MsgPack::OBJECT; }
+    bool is_extension() const { return type() == MsgPack::EXTENSION; }
+
+    // Number of elements of an array, key/value pairs of an object, or bytes
+    // of a string, binary or extension payload; 0 otherwise.
+    size_t size() const;
+
+    // Scalar accessors, converting like the MsgPack accessors of the same name.
+    bool bool_value() const;
+    double number_value() const;
+    int32_t int_value() const;
+    int64_t int64_value() const;
+    uint64_t uint64_value() const;
+    // Payloads, pointing into the input. nullptr if the type does not match.
+    const char *string_data() const;
+    const uint8_t *binary_data() const;
+    const uint8_t *extension_data() const;
+    int8_t extension_type() const;
+
+    // Return element i of an array.
+    MsgPackElement operator[](size_t i) const;
+    // Return the value for key of an object.
+    MsgPackElement operator[](const std::string &key) const;
+    template <class T, typename std::enable_if<
+        std::is_same<T, const char *>::value || std::is_same<T, char *>::value,
+            int>::type = 0>
+    MsgPackElement operator[](T key) const { return get(key, std::char_traits<char>::length(key)); }
+    MsgPackElement get(const char *key, size_t len) const;
+    // Return the key and value of pair i of an object.
+    MsgPackElement key(size_t i) const;
+    MsgPackElement value(size_t i) const;
+
+    // Build a MsgPack for this value and everything below it.
+    MsgPack to_msgpack() const;
+
+private:
+    friend class MsgPackDocument;
+    MsgPackElement(const MsgPackDocument *doc, uint32_t index) : m_doc(doc), m_index(index) {}
+
+    bool token(MsgPackToken &token) const;
+    MsgPack scalar() const;
+    const uint8_t *payload(MsgPack::Type type) const;
+    MsgPackElement child(size_t i) const;
+
+    const MsgPackDocument *m_doc;
+    uint32_t m_index;
+};
+
+/* MsgPackDocument
+ *
+ * Two-pass parser over a memory buffer. parse() makes one pass recording a
+ * tape with an entry per token: its offset, type, size and the index of the
+ * entry after its subtree, plus a table of the entries of the elements of
+ * each container. MsgPackElement then navigates the tape, reaching element i
+ * in O(1), and decodes only what it reads. The input is not
+ * copied and must outlive the document.
+ */
+class MsgPackDocument final {
+public:
+    MsgPackDocument() : m_data(nullptr), m_size(0), m_used(0) {}
+
+    // Index the first value in the input. If parse fails, return false,
+    // leave the document empty and assign an error message to err.
+    bool parse(const uint8_t *data, size_t len, std::string &err);
+    bool parse(const char *data, size_t len, std::string &err);
+
+    // Return the top-level value, or a NUL element if nothing is parsed.
+    MsgPackElement root() const;
+    // Return the number of bytes taken by the top-level value.
+    size_t parsed_size() const;
+
+private:
+    friend class MsgPackElement;
+
+    struct TapeEntry {
+        size_t offset;
+        MsgPack::Type type;
+        uint32_t length;
+        // Index of the entry after this value and all its elements.
+        uint32_t next;
+        // For an array or object, where the indices of its elements start
+        // in m_children.
+        size_t children;
+    };
+
+    const uint8_t *m_data;
+    size_t m_size;
+    size_t m_used;
+    std::vector<TapeEntry> m_tape;
+    // Tape indices of the elements of each array, and the keys and values
+    // of each object, so that element i is found in O(1).
+    std::vector<uint32_t> m_children;
+};
+
+/* MsgPackVisitor
+ *
+ * Receives the values of a document from MsgPack::parse(in, len, visitor, err)
+ * in wire order. Arrays report their elements between on_array_begin() and
+ * on_array_end(); maps report key, value, key, value, ... between
+ * on_map_begin() and on_map_end(). Strings, binaries and extension payloads
+ * point into the input buffer. Return false from any callback to stop the
+ * parse.
+ */
+class MsgPackVisitor {
+public:
+    virtual bool on_nil() { return true; }
+    virtual bool on_bool(bool) { return true; }
+    virtual bool on_int(int64_t) { return true; }
+    virtual bool on_uint(uint64_t) { return true; }
+    virtual bool on_float32(float) { return true; }
+    virtual bool on_float64(double) { return true; }
+    virtual bool on_string(const char *, size_t) { return true; }
+    virtual bool on_binary(const uint8_t *, size_t) { return true; }
+    virtual bool on_extension(int8_t, const uint8_t *, size_t) { return true; }
+    virtual bool on_array_begin(uint32_t) { return true; }
+    virtual bool on_array_end() { return true; }
+    virtual bool on_map_begin(uint32_t) { return true; }
+    virtual bool on_map_end() { return true; }
+    virtual ~MsgPackVisitor() {}
 };
 
 } // namespace msgpack11
@@ -102,3 +102,23 @@ TEST(MSGPACK_ARRAY, pack_unpack_object_array)
     msgpack11::MsgPack::array v2 = parsed.array_items();
     EXPECT_TRUE(v1 == v2);
 }
+
+TEST(MSGPACK_ARRAY, compare_nested)
+{
+    using msgpack11::MsgPack;
+    MsgPack const a = MsgPack::array { 1, MsgPack::array { 2, MsgPack::object { { "k", 3 } } } };
+    MsgPack const same = MsgPack::array { static_cast<uint8_t>(1), MsgPack::array { 2, MsgPack::object { { "k", 3 } } } };
+    MsgPack const deeper_greater = MsgPack::array { 1, MsgPack::array { 2, MsgPack::object { { "k", 4 } } } };
+    MsgPack const longer = MsgPack::array { 1, MsgPack::array { 2, MsgPack::object { { "k", 3 } }, 0 } };
+
+    EXPECT_TRUE(a == same);
+    EXPECT_FALSE(a < same);
+    EXPECT_FALSE(same < a);
+    EXPECT_FALSE(a == deeper_greater);
+    EXPECT_TRUE(a < deeper_greater);
+    EXPECT_FALSE(deeper_greater < a);
+    EXPECT_FALSE(a == longer);
+    EXPECT_TRUE(a < longer);
+    EXPECT_TRUE(longer < deeper_greater);
+    EXPECT_EQ(MsgPack::ARRAY < MsgPack::OBJECT, a < MsgPack(MsgPack::object {}));
+}
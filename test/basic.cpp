@@ -14,6 +14,10 @@
 
 #include <gtest/gtest.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+
 #if defined(_MSC_VER) || defined(__MINGW32__)
 #define msgpack_rand() ((double)rand() / RAND_MAX)
 #else  // _MSC_VER || __MINGW32__
@@ -1133,3 +1137,297 @@ TEST(MSGPACK_PREDICATES, predicates_extension)
     EXPECT_FALSE(extension_value.is_object());
     EXPECT_TRUE(extension_value.is_extension());
 }
+
+TEST(MSGPACK_DUMP, dump_to_buffer)
+{
+    msgpack11::MsgPack packed{ msgpack11::MsgPack::object {
+        { "key1", "value1" },
+        { "key2", msgpack11::MsgPack::array { 1, -2, 3.5 } },
+        { "key3", msgpack11::MsgPack::binary { 0, 2, 4, 6 } }
+    } };
+    std::string const expected = packed.dump();
+
+    std::string str_out(1024, 'x');
+    size_t const str_capacity = str_out.capacity();
+    packed.dump(str_out);
+    EXPECT_EQ(expected, str_out);
+    EXPECT_EQ(str_capacity, str_out.capacity());
+
+    msgpack11::MsgPack::binary bin_out(1024, 0xff);
+    size_t const bin_capacity = bin_out.capacity();
+    packed.dump(bin_out);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), bin_out.begin(),
+                           [](char a, uint8_t b) { return static_cast<uint8_t>(a) == b; }));
+    EXPECT_EQ(expected.size(), bin_out.size());
+    EXPECT_EQ(bin_capacity, bin_out.capacity());
+
+    std::string appended{"prefix"};
+    packed.dump_append(appended);
+    EXPECT_EQ("prefix" + expected, appended);
+}
+
+TEST(MSGPACK_DUMP, dump_parallel)
+{
+    msgpack11::MsgPack::array records;
+    msgpack11::MsgPack::object index;
+    for (int i = 0; i < 20000; ++i) {
+        records.push_back(msgpack11::MsgPack::object { { "id", i }, { "name", std::string(static_cast<size_t>(i % 20), 'r') } });
+        index[msgpack11::MsgPack(i)] = i * 0.25;
+    }
+
+    for (msgpack11::MsgPack const& packed : { msgpack11::MsgPack(records), msgpack11::MsgPack(index), msgpack11::MsgPack("small") }) {
+        std::string const expected = packed.dump();
+        for (unsigned threads : { 0u, 1u, 3u }) {
+            std::string str_out{"stale"};
+            packed.dump(str_out, threads);
+            EXPECT_EQ(expected, str_out);
+
+            msgpack11::MsgPack::binary bin_out;
+            packed.dump(bin_out, threads);
+            EXPECT_EQ(msgpack11::MsgPack::binary(expected.begin(), expected.end()), bin_out);
+        }
+    }
+}
+
+TEST(MSGPACK_DUMP, dump_deep)
+{
+    // Far deeper than the parser accepts; dump() must not recurse per level.
+    int const depth = 10000;
+    msgpack11::MsgPack value = msgpack11::MsgPack::array { "leaf" };
+    std::string expected = "\x91\xa4leaf";
+    for (int i = 0; i < depth; ++i) {
+        value = (i % 2 == 0) ? msgpack11::MsgPack(msgpack11::MsgPack::object { { value, i % 128 } })
+                             : msgpack11::MsgPack(msgpack11::MsgPack::array { i % 128, value, nullptr });
+        expected = (i % 2 == 0) ? "\x81" + expected + static_cast<char>(i % 128)
+                                : "\x93" + std::string(1, static_cast<char>(i % 128)) + expected + "\xc0";
+    }
+
+    EXPECT_EQ(expected.size(), value.encoded_size());
+    EXPECT_EQ(expected, value.dump());
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+namespace {
+void* run_test_body(void* body) {
+    (*static_cast<void (**)()>(body))();
+    return nullptr;
+}
+
+// Run body on a thread whose stack is far too small to recurse once per level
+// of the documents it handles.
+void run_on_small_stack(void (*body)()) {
+    pthread_attr_t attr;
+    ASSERT_EQ(0, pthread_attr_init(&attr));
+    ASSERT_EQ(0, pthread_attr_setstacksize(&attr, 256 * 1024));
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, &attr, run_test_body, &body));
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+}
+}
+
+TEST(MSGPACK_DUMP, deep_on_small_stack)
+{
+    run_on_small_stack([] {
+        // Arrays and maps nested alternately, 100000 levels deep.
+        int const depth = 100000;
+        std::string dumped;
+        for (int i = 0; i < depth; ++i) {
+            dumped += (i % 2 == 0) ? "\x91" : "\x81\xa1k";
+        }
+        dumped += '\x01';
+
+        msgpack11::MsgPack::ParseOptions options;
+        options.max_depth = depth;
+        std::string greater = dumped;
+        greater.back() = '\x02';
+        for (bool const use_arena : { false, true }) {
+            options.use_arena = use_arena;
+            std::string err;
+            msgpack11::MsgPack parsed = msgpack11::MsgPack::parse(dumped.data(), dumped.size(), err, options);
+            EXPECT_TRUE(err.empty());
+            EXPECT_EQ(dumped, parsed.dump());
+            EXPECT_EQ(dumped.size(), parsed.encoded_size());
+
+            msgpack11::MsgPack const other = msgpack11::MsgPack::parse(greater.data(), greater.size(), err, options);
+            EXPECT_TRUE(parsed == parsed);
+            EXPECT_FALSE(parsed == other);
+            EXPECT_TRUE(parsed < other);
+            EXPECT_FALSE(other < parsed);
+            parsed = nullptr;
+        }
+    });
+}
+#endif
+
+TEST(MSGPACK_DUMP, encoded_size)
+{
+    msgpack11::MsgPack::array values {
+        nullptr, true, false, 1.5f, 2.5,
+        static_cast<int8_t>(-33), static_cast<int8_t>(-32), static_cast<int8_t>(127),
+        static_cast<int16_t>(-129), static_cast<int16_t>(300),
+        static_cast<int32_t>(-32769), static_cast<int32_t>(70000),
+        static_cast<int64_t>(-2147483649LL), static_cast<int64_t>(5000000000LL),
+        static_cast<uint8_t>(127), static_cast<uint8_t>(128),
+        static_cast<uint16_t>(255), static_cast<uint16_t>(256),
+        static_cast<uint32_t>(65535), static_cast<uint32_t>(65536),
+        static_cast<uint64_t>(4294967295ULL), static_cast<uint64_t>(4294967296ULL),
+        std::string(31, 'a'), std::string(32, 'a'), std::string(256, 'a'), std::string(65536, 'a'),
+        msgpack11::MsgPack::binary(255), msgpack11::MsgPack::binary(256), msgpack11::MsgPack::binary(65536),
+        msgpack11::MsgPack::extension{1, msgpack11::MsgPack::binary(4)},
+        msgpack11::MsgPack::extension{1, msgpack11::MsgPack::binary(5)},
+        msgpack11::MsgPack::extension{1, msgpack11::MsgPack::binary(256)},
+        msgpack11::MsgPack::array(15), msgpack11::MsgPack::array(16),
+        msgpack11::MsgPack::object { { "key", msgpack11::MsgPack::array { 1, 2, 3 } } }
+    };
+
+    for (const msgpack11::MsgPack& value : values) {
+        EXPECT_EQ(value.dump().size(), value.encoded_size());
+    }
+
+    msgpack11::MsgPack packed{values};
+    EXPECT_EQ(packed.dump().size(), packed.encoded_size());
+    EXPECT_EQ(packed.dump().size(), packed.encoded_size());
+}
+
+TEST(MSGPACK_PARSE, parse_with_arena)
+{
+    msgpack11::MsgPack const original = msgpack11::MsgPack::object {
+        { "ints", msgpack11::MsgPack::array { 1, -200, 70000, static_cast<uint64_t>(5000000000ULL) } },
+        { "floats", msgpack11::MsgPack::array { 1.5f, 2.25 } },
+        { "strings", msgpack11::MsgPack::array { "a", std::string(300, 'b') } },
+        { "binary", msgpack11::MsgPack::binary(100, 0x55) },
+        { "extension", msgpack11::MsgPack::extension{ 3, msgpack11::MsgPack::binary(8, 1) } },
+        { "nested", msgpack11::MsgPack::object { { "nil", nullptr }, { "bool", true } } }
+    };
+    std::string const dumped = original.dump();
+
+    msgpack11::MsgPack::ParseOptions options;
+    options.use_arena = true;
+
+    std::string err;
+    msgpack11::MsgPack const parsed = msgpack11::MsgPack::parse(dumped.data(), dumped.size(), err, options);
+    EXPECT_TRUE(err.empty());
+    EXPECT_EQ(original, parsed);
+
+    // Values keep the arena alive after the document root is gone.
+    msgpack11::MsgPack inner;
+    {
+        msgpack11::MsgPack root = msgpack11::MsgPack::parse(dumped.data(), dumped.size(), err, options);
+        inner = root["strings"];
+    }
+    EXPECT_EQ(std::string(300, 'b'), inner[1].string_value());
+
+    msgpack11::MsgPack const truncated = msgpack11::MsgPack::parse(dumped.data(), dumped.size() - 1, err, options);
+    EXPECT_FALSE(err.empty());
+}
+
+TEST(MSGPACK_PARSE, parse_single_thread)
+{
+    msgpack11::MsgPack const original = msgpack11::MsgPack::object {
+        { "list", msgpack11::MsgPack::array { "x", msgpack11::MsgPack::binary(3, 1), 7 } },
+        { "nested", msgpack11::MsgPack::object { { "k", "v" } } }
+    };
+    std::string const dumped = original.dump();
+
+    for (bool const use_arena : { false, true }) {
+        msgpack11::MsgPack::ParseOptions options;
+        options.use_arena = use_arena;
+        options.single_thread = true;
+
+        std::string err;
+        msgpack11::MsgPack inner;
+        {
+            msgpack11::MsgPack root = msgpack11::MsgPack::parse(dumped.data(), dumped.size(), err, options);
+            EXPECT_TRUE(err.empty());
+            EXPECT_EQ(original, root);
+            msgpack11::MsgPack::array copies(10, root["list"]);
+            inner = copies[3];
+        }
+        EXPECT_EQ(original["list"], inner);
+    }
+}
+
+TEST(MSGPACK_PARSE, parse_nested)
+{
+    // 200 levels of arrays and objects below the top level are accepted.
+    msgpack11::MsgPack expected = msgpack11::MsgPack::array {};
+    for (int i = 0; i < 100; ++i) {
+        expected = msgpack11::MsgPack::object { { "k", expected }, { "l", i } };
+        expected = msgpack11::MsgPack::array { expected, msgpack11::MsgPack::object {} };
+    }
+    std::string const dumped = expected.dump();
+
+    std::string err;
+    EXPECT_EQ(expected, msgpack11::MsgPack::parse(dumped, err));
+    EXPECT_TRUE(err.empty());
+
+    std::string const deeper = "\x91" + dumped;
+    EXPECT_TRUE(msgpack11::MsgPack::parse(deeper, err).is_null());
+    EXPECT_FALSE(err.empty());
+}
+
+TEST(MSGPACK_VALUE, copy_and_move_between_inline_and_heap)
+{
+    msgpack11::MsgPack value(static_cast<int64_t>(-5));
+    msgpack11::MsgPack const str("text");
+
+    value = str;
+    EXPECT_EQ("text", value.string_value());
+    value = 2.5;
+    EXPECT_EQ(2.5, value.float64_value());
+    EXPECT_EQ(msgpack11::MsgPack(2.5f), value);
+
+    msgpack11::MsgPack moved(msgpack11::MsgPack::array { 1, "two" });
+    msgpack11::MsgPack target(std::move(moved));
+    EXPECT_TRUE(moved.is_null());
+    EXPECT_EQ(2u, target.array_items().size());
+
+    target = std::move(target[1]);
+    EXPECT_EQ("two", target.string_value());
+
+    EXPECT_EQ(msgpack11::MsgPack(static_cast<uint8_t>(7)), msgpack11::MsgPack(static_cast<int64_t>(7)));
+    EXPECT_TRUE(msgpack11::MsgPack(static_cast<int8_t>(-1)) < msgpack11::MsgPack(static_cast<uint64_t>(0)));
+    EXPECT_EQ(static_cast<int32_t>(-3), msgpack11::MsgPack(static_cast<int16_t>(-3)).int32_value());
+
+    // A handle is its type tag next to one word of payload or pointer.
+    EXPECT_LE(sizeof(msgpack11::MsgPack), 2 * sizeof(uint64_t));
+}
+
+TEST(MSGPACK_PARSE, parse_borrowed_payloads)
+{
+    msgpack11::MsgPack const original = msgpack11::MsgPack::object {
+        { "name", std::string(40, 'n') },
+        { "blob", msgpack11::MsgPack::binary(70000, 0x42) },
+        { "list", msgpack11::MsgPack::array { "x", msgpack11::MsgPack::binary(3, 1) } }
+    };
+    std::shared_ptr<std::string> input = std::make_shared<std::string>(original.dump());
+
+    msgpack11::MsgPack::ParseOptions options;
+    options.borrow_payloads = true;
+    options.input_owner = input;
+
+    std::string err;
+    msgpack11::MsgPack parsed = msgpack11::MsgPack::parse(input->data(), input->size(), err, options);
+    EXPECT_TRUE(err.empty());
+    EXPECT_EQ(original, parsed);
+
+    // Payloads point into the input rather than into copies.
+    const char* const begin = input->data();
+    const char* const end = begin + input->size();
+    msgpack11::MsgPack const& blob = parsed["blob"];
+    EXPECT_EQ(70000u, blob.binary_size());
+    EXPECT_TRUE(begin <= reinterpret_cast<const char*>(blob.binary_data()) &&
+                reinterpret_cast<const char*>(blob.binary_data()) < end);
+    EXPECT_TRUE(begin <= parsed["name"].string_data() && parsed["name"].string_data() < end);
+
+    // The values keep the input alive and still dump and materialize.
+    msgpack11::MsgPack list = parsed["list"];
+    parsed = msgpack11::MsgPack();
+    input.reset();
+    EXPECT_EQ("x", list[0].string_value());
+    EXPECT_EQ(msgpack11::MsgPack::binary(3, 1), list[1].binary_items());
+    EXPECT_EQ(original["list"].dump(), list.dump());
+    EXPECT_EQ(msgpack11::MsgPack("x"), list[0]);
+    EXPECT_TRUE(msgpack11::MsgPack("w") < list[0]);
+}
@@ -0,0 +1,212 @@
+#include <msgpack11.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+struct Point {
+    int32_t x;
+    int32_t y;
+    MSGPACK11_FIELDS(x, y)
+
+    bool operator==(const Point& other) const { return x == other.x && y == other.y; }
+};
+
+struct Shape {
+    std::string name;
+    std::vector<Point> points;
+    std::map<std::string, double> weights;
+    msgpack11::MsgPack::binary blob;
+    std::tuple<bool, uint8_t, std::string> flags;
+    std::pair<int64_t, float> range;
+    std::deque<uint16_t> ids;
+    msgpack11::MsgPack extra;
+    MSGPACK11_FIELDS(name, points, weights, blob, flags, range, ids, extra)
+};
+}
+
+TEST(MSGPACK_CODEC, encode_matches_dump)
+{
+    Shape shape;
+    shape.name = "square";
+    shape.points = { { 0, 0 }, { 0, -40000 }, { 300, 1 } };
+    shape.weights = { { "a", 1.5 }, { "b", -2.0 } };
+    shape.blob = { 1, 2, 3 };
+    shape.flags = std::make_tuple(true, 200, "f");
+    shape.range = std::make_pair(-5000000000LL, 0.5f);
+    shape.ids = { 1, 65535 };
+    shape.extra = msgpack11::MsgPack::object { { "k", msgpack11::MsgPack::array { nullptr, "v" } } };
+
+    msgpack11::MsgPack const expected = msgpack11::MsgPack::array {
+        "square",
+        msgpack11::MsgPack::array {
+            msgpack11::MsgPack::array { 0, 0 },
+            msgpack11::MsgPack::array { 0, -40000 },
+            msgpack11::MsgPack::array { 300, 1 }
+        },
+        msgpack11::MsgPack::object { { "a", 1.5 }, { "b", -2.0 } },
+        msgpack11::MsgPack::binary { 1, 2, 3 },
+        msgpack11::MsgPack::array { true, 200, "f" },
+        msgpack11::MsgPack::array { static_cast<int64_t>(-5000000000LL), 0.5f },
+        msgpack11::MsgPack::array { 1, 65535 },
+        shape.extra
+    };
+
+    std::string const encoded = msgpack11::encode(shape);
+    EXPECT_EQ(expected.dump(), encoded);
+
+    Shape decoded;
+    std::string err;
+    ASSERT_TRUE(msgpack11::decode(encoded, decoded, err));
+    EXPECT_EQ(shape.name, decoded.name);
+    EXPECT_EQ(shape.points, decoded.points);
+    EXPECT_EQ(shape.weights, decoded.weights);
+    EXPECT_EQ(shape.blob, decoded.blob);
+    EXPECT_EQ(shape.flags, decoded.flags);
+    EXPECT_EQ(shape.range, decoded.range);
+    EXPECT_EQ(shape.ids, decoded.ids);
+    EXPECT_EQ(shape.extra, decoded.extra);
+}
+
+TEST(MSGPACK_CODEC, decode_numbers)
+{
+    std::string err;
+    std::string const small = msgpack11::MsgPack(static_cast<int64_t>(-3)).dump();
+    std::string const large = msgpack11::MsgPack(static_cast<uint64_t>(300)).dump();
+
+    int8_t i8 = 0;
+    EXPECT_TRUE(msgpack11::decode(small, i8, err));
+    EXPECT_EQ(-3, i8);
+    EXPECT_FALSE(msgpack11::decode(large, i8, err));
+    EXPECT_EQ("type mismatch.", err);
+
+    uint64_t u64 = 0;
+    EXPECT_FALSE(msgpack11::decode(small, u64, err));
+    EXPECT_TRUE(msgpack11::decode(large, u64, err));
+    EXPECT_EQ(300u, u64);
+
+    int64_t i64 = 0;
+    EXPECT_TRUE(msgpack11::decode(msgpack11::MsgPack(std::numeric_limits<uint64_t>::max()).dump(), u64, err));
+    EXPECT_EQ(std::numeric_limits<uint64_t>::max(), u64);
+    EXPECT_FALSE(msgpack11::decode(msgpack11::MsgPack(std::numeric_limits<uint64_t>::max()).dump(), i64, err));
+    EXPECT_TRUE(msgpack11::decode(msgpack11::MsgPack(std::numeric_limits<int64_t>::min()).dump(), i64, err));
+    EXPECT_EQ(std::numeric_limits<int64_t>::min(), i64);
+
+    double d = 0;
+    EXPECT_TRUE(msgpack11::decode(large, d, err));
+    EXPECT_EQ(300.0, d);
+    EXPECT_FALSE(msgpack11::decode(msgpack11::MsgPack("300").dump(), d, err));
+}
+
+TEST(MSGPACK_CODEC, decode_errors)
+{
+    std::string err;
+    Point point;
+
+    std::string const wrong_arity = msgpack11::MsgPack(msgpack11::MsgPack::array { 1, 2, 3 }).dump();
+    EXPECT_FALSE(msgpack11::decode(wrong_arity, point, err));
+    EXPECT_EQ("type mismatch.", err);
+
+    std::string const truncated = msgpack11::encode(Point{ 1, 70000 });
+    EXPECT_FALSE(msgpack11::decode(truncated.data(), truncated.size() - 1, point, err));
+    EXPECT_EQ("end of buffer.", err);
+
+    std::map<std::string, int> map;
+    std::string const duplicated = "\x82\xa1k\x01\xa1k\x02";
+    ASSERT_TRUE(msgpack11::decode(duplicated, map, err));
+    EXPECT_EQ(1u, map.size());
+    EXPECT_EQ(1, map["k"]);
+}
+
+namespace {
+// Return the values as a MsgPack array, so that dump() gives the reference
+// encoding.
+template <typename T>
+msgpack11::MsgPack as_array(const std::vector<T>& values)
+{
+    msgpack11::MsgPack::array ret;
+    for (T value : values) {
+        ret.push_back(msgpack11::MsgPack(value));
+    }
+    return ret;
+}
+
+template <typename T>
+void check_round_trip(const std::vector<T>& values)
+{
+    std::string const encoded = msgpack11::encode(values);
+    EXPECT_EQ(as_array(values).dump(), encoded);
+
+    std::vector<T> decoded;
+    std::string err;
+    ASSERT_TRUE(msgpack11::decode(encoded, decoded, err));
+    EXPECT_EQ(values, decoded);
+}
+}
+
+TEST(MSGPACK_CODEC, numeric_arrays)
+{
+    // Long fixint runs take the bulk path; the outliers force the fallback
+    // in the middle of a block.
+    std::vector<int32_t> int32s;
+    std::vector<int16_t> int16s;
+    std::vector<uint64_t> uint64s;
+    std::vector<double> doubles;
+    std::vector<float> floats;
+    for (int i = 0; i < 1000; ++i) {
+        int32_t const small = i % 160 - 32;
+        int32s.push_back((i % 97 == 0) ? -70000 * i : small);
+        int16s.push_back(static_cast<int16_t>((i % 53 == 0) ? -300 : small));
+        uint64s.push_back((i % 89 == 0) ? 5000000000ULL * i : static_cast<uint64_t>(i % 128));
+        doubles.push_back(i * 0.25 - 100);
+        floats.push_back(static_cast<float>(i) / 3);
+    }
+    check_round_trip(int32s);
+    check_round_trip(int16s);
+    check_round_trip(uint64s);
+    check_round_trip(doubles);
+    check_round_trip(floats);
+    check_round_trip(std::vector<int8_t> { -128, -33, -32, 0, 127 });
+    check_round_trip(std::vector<uint16_t>(0));
+    check_round_trip(std::vector<int64_t> { std::numeric_limits<int64_t>::min(), -1, 0, std::numeric_limits<int64_t>::max() });
+}
+
+TEST(MSGPACK_CODEC, numeric_arrays_convert_per_element)
+{
+    std::string const mixed = msgpack11::MsgPack(msgpack11::MsgPack::array { 1, 2.5, 1.5f, -7, 300 }).dump();
+    std::string err;
+
+    std::vector<double> doubles;
+    ASSERT_TRUE(msgpack11::decode(mixed, doubles, err));
+    EXPECT_EQ((std::vector<double> { 1, 2.5, 1.5, -7, 300 }), doubles);
+
+    // A FLOAT32 among FLOAT64s ends a block of bulk decoded values.
+    msgpack11::MsgPack::array wide;
+    std::vector<double> expected;
+    for (int i = 0; i < 11; ++i) {
+        double const value = i * 1.25 - 3;
+        wide.push_back((i == 6) ? msgpack11::MsgPack(static_cast<float>(value)) : msgpack11::MsgPack(value));
+        expected.push_back(value);
+    }
+    ASSERT_TRUE(msgpack11::decode(msgpack11::MsgPack(wide).dump(), doubles, err));
+    EXPECT_EQ(expected, doubles);
+
+    std::vector<uint16_t> shorts;
+    std::string const negative = msgpack11::MsgPack(msgpack11::MsgPack::array { 1, 2, -1 }).dump();
+    EXPECT_FALSE(msgpack11::decode(negative, shorts, err));
+    EXPECT_EQ("type mismatch.", err);
+
+    // A length far beyond the input fails at the end of the buffer.
+    std::string const bogus_length = "\xdd\xff\xff\xff\xff\x01\x02";
+    std::vector<int32_t> ints;
+    EXPECT_FALSE(msgpack11::decode(bogus_length, ints, err));
+    EXPECT_EQ("end of buffer.", err);
+}
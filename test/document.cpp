@@ -0,0 +1,95 @@
+#include <msgpack11.hpp>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+TEST(MSGPACK_DOCUMENT, navigate)
+{
+    msgpack11::MsgPack packed{ msgpack11::MsgPack::object {
+        { "id", 42 },
+        { "name", "abc" },
+        { "nested", msgpack11::MsgPack::array {
+            msgpack11::MsgPack::array { 1, 2, 3 },
+            msgpack11::MsgPack::object { { "x", -1.5 } },
+            true
+        } },
+        { "blob", msgpack11::MsgPack::binary { 1, 2 } },
+        { "ext", msgpack11::MsgPack::extension { 5, msgpack11::MsgPack::binary { 9 } } }
+    } };
+    std::string dumped = packed.dump() + "trailing";
+
+    msgpack11::MsgPackDocument doc;
+    std::string err;
+    ASSERT_TRUE(doc.parse(dumped.data(), dumped.size(), err));
+    EXPECT_EQ(dumped.size() - 8, doc.parsed_size());
+
+    msgpack11::MsgPackElement root = doc.root();
+    EXPECT_TRUE(root.is_object());
+    EXPECT_EQ(5u, root.size());
+    EXPECT_EQ(42, root["id"].int_value());
+    EXPECT_EQ("abc", std::string(root["name"].string_data(), root["name"].size()));
+    EXPECT_TRUE(root["missing"].is_null());
+
+    msgpack11::MsgPackElement nested = root["nested"];
+    EXPECT_EQ(3u, nested.size());
+    EXPECT_EQ(3, nested[0][2].int64_value());
+    EXPECT_EQ(-1.5, nested[1]["x"].number_value());
+    EXPECT_TRUE(nested[2].bool_value());
+    EXPECT_TRUE(nested[3].is_null());
+
+    EXPECT_EQ(2u, root["blob"].size());
+    EXPECT_EQ(2, root["blob"].binary_data()[1]);
+    EXPECT_EQ(5, root["ext"].extension_type());
+    EXPECT_EQ(9, root["ext"].extension_data()[0]);
+    EXPECT_TRUE(root["id"].string_data() == nullptr);
+
+    EXPECT_EQ("blob", std::string(root.key(0).string_data(), root.key(0).size()));
+    EXPECT_EQ(packed["nested"], nested.to_msgpack());
+    EXPECT_EQ(packed, root.to_msgpack());
+}
+
+TEST(MSGPACK_DOCUMENT, malformed)
+{
+    std::string dumped = msgpack11::MsgPack(msgpack11::MsgPack::array { 1, "abc" }).dump();
+
+    msgpack11::MsgPackDocument doc;
+    std::string err;
+    EXPECT_FALSE(doc.parse(dumped.data(), dumped.size() - 1, err));
+    EXPECT_FALSE(err.empty());
+    EXPECT_TRUE(doc.root().is_null());
+
+    const char invalid[] = { '\x91', '\xc1' };
+    EXPECT_FALSE(doc.parse(invalid, sizeof(invalid), err));
+    EXPECT_TRUE(doc.root().is_null());
+}
+
+TEST(MSGPACK_DOCUMENT, large_and_deep)
+{
+    msgpack11::MsgPack::array wide;
+    for (int i = 0; i < 100000; ++i) {
+        wide.push_back(msgpack11::MsgPack::array { i });
+    }
+    std::string dumped = msgpack11::MsgPack(wide).dump();
+
+    msgpack11::MsgPackDocument doc;
+    std::string err;
+    ASSERT_TRUE(doc.parse(dumped.data(), dumped.size(), err));
+    for (int i = 0; i < 100000; ++i) {
+        EXPECT_EQ(i, doc.root()[i][0].int64_value());
+    }
+
+    // Deeper than parse() accepts by default.
+    std::string deep(1000, '\x91');
+    deep.push_back('\x07');
+    ASSERT_TRUE(doc.parse(deep.data(), deep.size(), err));
+    msgpack11::MsgPack::ParseOptions options;
+    options.max_depth = 2000;
+    EXPECT_EQ(msgpack11::MsgPack::parse(deep.data() + 1, deep.size() - 1, err, options), doc.root()[0].to_msgpack());
+    EXPECT_FALSE(doc.root()[0].to_msgpack().is_null());
+
+    // An array declaring more elements than bytes remain.
+    const char truncated[] = { '\xdd', '\x7f', '\xff', '\xff', '\xff', '\x01' };
+    EXPECT_FALSE(doc.parse(truncated, sizeof(truncated), err));
+    EXPECT_FALSE(err.empty());
+}
@@ -0,0 +1,134 @@
+#include <msgpack11.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+struct GeoPoint {
+    float lat;
+    float lon;
+};
+}
+
+namespace msgpack11 {
+template <>
+struct MsgPackExtensionTraits<GeoPoint> {
+    static int8_t type() { return 3; }
+    static bool decode(const uint8_t * data, size_t len, GeoPoint & value) {
+        if (len != 8) {
+            return false;
+        }
+        uint32_t bits[2];
+        for (int i = 0; i < 2; ++i) {
+            bits[i] = (uint32_t(data[4 * i]) << 24) | (uint32_t(data[4 * i + 1]) << 16) |
+                      (uint32_t(data[4 * i + 2]) << 8) | uint32_t(data[4 * i + 3]);
+        }
+        std::memcpy(&value.lat, &bits[0], 4);
+        std::memcpy(&value.lon, &bits[1], 4);
+        return true;
+    }
+    static size_t encode(const GeoPoint & value, uint8_t * out) {
+        uint32_t bits[2];
+        std::memcpy(&bits[0], &value.lat, 4);
+        std::memcpy(&bits[1], &value.lon, 4);
+        for (int i = 0; i < 2; ++i) {
+            out[4 * i] = uint8_t(bits[i] >> 24);
+            out[4 * i + 1] = uint8_t(bits[i] >> 16);
+            out[4 * i + 2] = uint8_t(bits[i] >> 8);
+            out[4 * i + 3] = uint8_t(bits[i]);
+        }
+        return 8;
+    }
+};
+}
+
+namespace {
+msgpack11::MsgPack::extension geo_extension(const GeoPoint& point) {
+    uint8_t payload[8];
+    msgpack11::MsgPackExtensionTraits<GeoPoint>::encode(point, payload);
+    return msgpack11::MsgPack::extension(3, msgpack11::MsgPack::binary(payload, payload + 8));
+}
+
+// Codec claiming values larger than a native extension can hold.
+class OversizedCodec final : public msgpack11::MsgPackExtensionCodec {
+public:
+    OversizedCodec() : MsgPackExtensionCodec(4, max_value_size + 1) {}
+    bool decode(const uint8_t *, size_t, void *) const override { return false; }
+    size_t encode(const void *, uint8_t *) const override { return 0; }
+};
+}
+
+TEST(MSGPACK_EXTENSION, decodes_registered_types_while_parsing)
+{
+    msgpack11::MsgPack const plain = msgpack11::MsgPack::array {
+        geo_extension({ 51.5f, -0.125f }),
+        msgpack11::MsgPack::timestamp { 1700000000, 5 },
+        msgpack11::MsgPack::extension(5, msgpack11::MsgPack::binary(2, 1)),
+        msgpack11::MsgPack::extension(3, msgpack11::MsgPack::binary(3, 1)),
+    };
+    std::string const dumped = plain.dump();
+
+    msgpack11::MsgPackExtensionRegistry registry;
+    registry.add<GeoPoint>();
+    registry.add<msgpack11::MsgPack::timestamp>();
+    for (bool use_arena : { false, true }) {
+        msgpack11::MsgPack::ParseOptions options;
+        options.extensions = &registry;
+        options.use_arena = use_arena;
+        std::string err;
+        msgpack11::MsgPack const parsed = msgpack11::MsgPack::parse(dumped.data(), dumped.size(), err, options);
+        ASSERT_TRUE(err.empty());
+
+        const GeoPoint* const point = parsed[0].extension_value<GeoPoint>();
+        ASSERT_NE(nullptr, point);
+        EXPECT_EQ(51.5f, point->lat);
+        EXPECT_EQ(-0.125f, point->lon);
+        EXPECT_EQ(nullptr, parsed[0].extension_value<msgpack11::MsgPack::timestamp>());
+
+        ASSERT_NE(nullptr, parsed[1].extension_value<msgpack11::MsgPack::timestamp>());
+        EXPECT_TRUE(parsed[1].is_timestamp());
+        EXPECT_EQ(5u, parsed[1].timestamp_value().nanoseconds);
+
+        // No codec for type 5, and an invalid payload for type 3.
+        EXPECT_EQ(nullptr, parsed[2].extension_value<GeoPoint>());
+        EXPECT_EQ(nullptr, parsed[3].extension_value<GeoPoint>());
+
+        EXPECT_EQ(plain, parsed);
+        EXPECT_EQ(parsed, plain);
+        EXPECT_EQ(plain[0].extension_items(), parsed[0].extension_items());
+        EXPECT_EQ(dumped, parsed.dump());
+        EXPECT_EQ(dumped.size(), parsed.encoded_size());
+    }
+
+    std::string err;
+    EXPECT_EQ(nullptr, msgpack11::MsgPack::parse(dumped, err)[0].extension_value<GeoPoint>());
+}
+
+TEST(MSGPACK_EXTENSION, make_extension)
+{
+    GeoPoint const point = { 1.0f, 2.5f };
+    msgpack11::MsgPack const native = msgpack11::MsgPack::make_extension(point);
+    msgpack11::MsgPack const plain(geo_extension(point));
+
+    EXPECT_TRUE(native.is_extension());
+    ASSERT_NE(nullptr, native.extension_value<GeoPoint>());
+    EXPECT_EQ(2.5f, native.extension_value<GeoPoint>()->lon);
+    EXPECT_EQ(nullptr, plain.extension_value<GeoPoint>());
+    EXPECT_EQ(plain.dump(), native.dump());
+    EXPECT_EQ(plain, native);
+    EXPECT_FALSE(native < plain);
+    EXPECT_TRUE(native < msgpack11::MsgPack::make_extension(GeoPoint { 1.0f, 3.0f }));
+
+    msgpack11::MsgPack::timestamp const at = { 1, 2 };
+    EXPECT_EQ(msgpack11::MsgPack(at).dump(), msgpack11::MsgPack::make_extension(at).dump());
+    EXPECT_TRUE(at == msgpack11::MsgPack::make_extension(at).timestamp_value());
+}
+
+TEST(MSGPACK_EXTENSION, rejects_oversized_codec_values)
+{
+    EXPECT_THROW(OversizedCodec(), std::invalid_argument);
+}
@@ -38,3 +38,25 @@ TEST(MSGPACK_OBJECT, unpack_incomplete_data)
         EXPECT_GT(err.size(), 0);
     }
 }
+
+TEST(MSGPACK_OBJECT, unpack_incomplete_buffer)
+{
+    msgpack11::MsgPack::array array {
+        "value1", msgpack11::MsgPack::binary { 0, 2, 4, 6 }, 1024, 3.5
+    };
+
+    std::string dumped{msgpack11::MsgPack{array}.dump()};
+    std::vector<uint8_t> buffer(dumped.begin(), dumped.end());
+
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        std::string err;
+        msgpack11::MsgPack parsed{ msgpack11::MsgPack::parse(buffer.data(), i, err) };
+        EXPECT_EQ(err, "end of buffer.");
+        EXPECT_TRUE(parsed.is_null());
+    }
+
+    std::string err;
+    msgpack11::MsgPack parsed{ msgpack11::MsgPack::parse(buffer.data(), buffer.size(), err) };
+    EXPECT_TRUE(err.empty());
+    EXPECT_TRUE(parsed.array_items() == array);
+}
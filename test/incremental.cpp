@@ -0,0 +1,99 @@
+#include <msgpack11.hpp>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+std::vector<msgpack11::MsgPack> sample_values()
+{
+    return {
+        msgpack11::MsgPack::object {
+            { "key1", "value1" },
+            { "key2", msgpack11::MsgPack::array { 1, 2, msgpack11::MsgPack::array {} } },
+            { "key3", msgpack11::MsgPack::binary(300, 0xaa) }
+        },
+        std::string(70000, 'x'),
+        msgpack11::MsgPack::array { msgpack11::MsgPack::object {}, nullptr, 1.5 },
+        42
+    };
+}
+} // namespace
+
+TEST(MSGPACK_INCREMENTAL, feed_chunks)
+{
+    std::vector<msgpack11::MsgPack> const values = sample_values();
+    std::string dumped;
+    for (const msgpack11::MsgPack& value : values) {
+        value.dump_append(dumped);
+    }
+
+    for (size_t chunk : { size_t(1), size_t(7), size_t(4096), dumped.size() }) {
+        msgpack11::MsgPackIncrementalParser parser;
+        std::vector<msgpack11::MsgPack> parsed;
+        for (size_t pos = 0; pos < dumped.size(); pos += chunk) {
+            size_t const len = std::min(chunk, dumped.size() - pos);
+            ASSERT_TRUE(parser.feed(dumped.data() + pos, len));
+            msgpack11::MsgPack value;
+            while (parser.next(value)) {
+                parsed.push_back(value);
+            }
+        }
+        EXPECT_TRUE(parser.idle());
+        EXPECT_TRUE(values == parsed);
+    }
+}
+
+TEST(MSGPACK_INCREMENTAL, partial_value)
+{
+    std::string dumped = msgpack11::MsgPack{ msgpack11::MsgPack::array { "abc", 1 } }.dump();
+
+    msgpack11::MsgPackIncrementalParser parser;
+    msgpack11::MsgPack value;
+    EXPECT_TRUE(parser.feed(dumped.data(), dumped.size() - 1));
+    EXPECT_FALSE(parser.next(value));
+    EXPECT_FALSE(parser.idle());
+
+    EXPECT_TRUE(parser.feed(dumped.data() + dumped.size() - 1, 1));
+    EXPECT_TRUE(parser.next(value));
+    EXPECT_EQ("abc", value[0].string_value());
+    EXPECT_FALSE(parser.next(value));
+}
+
+TEST(MSGPACK_INCREMENTAL, malformed_input)
+{
+    std::string dumped = msgpack11::MsgPack{1}.dump() + "\xc1";
+
+    msgpack11::MsgPackIncrementalParser parser;
+    EXPECT_FALSE(parser.feed(dumped.data(), dumped.size()));
+    EXPECT_TRUE(parser.failed());
+
+    msgpack11::MsgPack value;
+    EXPECT_TRUE(parser.next(value));
+    EXPECT_EQ(1, value.int_value());
+
+    parser.reset();
+    EXPECT_FALSE(parser.failed());
+    EXPECT_TRUE(parser.feed(dumped.data(), 1));
+}
+
+TEST(MSGPACK_INCREMENTAL, depth_limit)
+{
+    std::string nested(1000, '\x91');
+    nested.push_back('\x01');
+
+    msgpack11::MsgPack::ParseOptions options;
+    options.max_depth = 1000;
+    msgpack11::MsgPackIncrementalParser parser(options);
+    EXPECT_TRUE(parser.feed(nested.data(), nested.size()));
+    msgpack11::MsgPack value;
+    ASSERT_TRUE(parser.next(value));
+    std::string err;
+    EXPECT_EQ(msgpack11::MsgPack::parse(nested.data(), nested.size(), err, options), value);
+
+    options.max_depth = 999;
+    msgpack11::MsgPackIncrementalParser shallow(options);
+    EXPECT_FALSE(shallow.feed(nested.data(), nested.size()));
+    EXPECT_TRUE(shallow.failed());
+}
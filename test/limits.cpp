@@ -0,0 +1,259 @@
+#include <msgpack11.hpp>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+msgpack11::MsgPack parse_with(const std::string& in, const msgpack11::MsgPack::ParseOptions& options, std::string& err) {
+    return msgpack11::MsgPack::parse(in.data(), in.size(), err, options);
+}
+}
+
+TEST(MSGPACK_LIMITS, defaults_accept_large_documents)
+{
+    msgpack11::MsgPack::array items(10000, msgpack11::MsgPack(std::string(100, 'x')));
+    msgpack11::MsgPack const expected(items);
+
+    std::string err;
+    EXPECT_EQ(expected, parse_with(expected.dump(), msgpack11::MsgPack::ParseOptions(), err));
+    EXPECT_TRUE(err.empty());
+}
+
+TEST(MSGPACK_LIMITS, max_depth)
+{
+    std::string const dumped = msgpack11::MsgPack(msgpack11::MsgPack::array {
+        msgpack11::MsgPack::array { msgpack11::MsgPack::array { 1 } } }).dump();
+    msgpack11::MsgPack::ParseOptions options;
+    std::string err;
+
+    // The innermost value is at level 3.
+    options.max_depth = 3;
+    EXPECT_FALSE(parse_with(dumped, options, err).is_null());
+    EXPECT_TRUE(err.empty());
+
+    options.max_depth = 2;
+    EXPECT_TRUE(parse_with(dumped, options, err).is_null());
+    EXPECT_EQ("exceeded parse limit.", err);
+}
+
+TEST(MSGPACK_LIMITS, max_elements)
+{
+    std::string const array = msgpack11::MsgPack(msgpack11::MsgPack::array { 1, 2, 3 }).dump();
+    std::string const object = msgpack11::MsgPack(msgpack11::MsgPack::object { { 1, 2 }, { 3, 4 } }).dump();
+    msgpack11::MsgPack::ParseOptions options;
+    std::string err;
+
+    options.max_elements = 3;
+    EXPECT_FALSE(parse_with(array, options, err).is_null());
+    EXPECT_TRUE(err.empty());
+
+    options.max_elements = 2;
+    EXPECT_TRUE(parse_with(array, options, err).is_null());
+    EXPECT_EQ("exceeded parse limit.", err);
+
+    err.clear();
+    EXPECT_FALSE(parse_with(object, options, err).is_null());
+    EXPECT_TRUE(err.empty());
+
+    options.max_elements = 1;
+    EXPECT_TRUE(parse_with(object, options, err).is_null());
+    EXPECT_EQ("exceeded parse limit.", err);
+}
+
+TEST(MSGPACK_LIMITS, max_payload)
+{
+    std::string const str = msgpack11::MsgPack("four").dump();
+    std::string const bin = msgpack11::MsgPack(msgpack11::MsgPack::binary(4, 0xab)).dump();
+    std::string const ext = msgpack11::MsgPack(msgpack11::MsgPack::extension(1, msgpack11::MsgPack::binary(4, 0))).dump();
+    msgpack11::MsgPack::ParseOptions options;
+    std::string err;
+
+    options.max_payload = 4;
+    for (const std::string& in : { str, bin, ext }) {
+        EXPECT_FALSE(parse_with(in, options, err).is_null());
+        EXPECT_TRUE(err.empty());
+    }
+
+    options.max_payload = 3;
+    for (const std::string& in : { str, bin, ext }) {
+        err.clear();
+        EXPECT_TRUE(parse_with(in, options, err).is_null());
+        EXPECT_EQ("exceeded parse limit.", err);
+    }
+}
+
+TEST(MSGPACK_LIMITS, max_nodes)
+{
+    // The array, two keys, two values and the nested array with its element.
+    std::string const dumped = msgpack11::MsgPack(msgpack11::MsgPack::array {
+        msgpack11::MsgPack::object { { "a", 1 }, { "b", msgpack11::MsgPack::array { true } } } }).dump();
+    msgpack11::MsgPack::ParseOptions options;
+    std::string err;
+
+    options.max_nodes = 7;
+    EXPECT_FALSE(parse_with(dumped, options, err).is_null());
+    EXPECT_TRUE(err.empty());
+
+    options.max_nodes = 6;
+    EXPECT_TRUE(parse_with(dumped, options, err).is_null());
+    EXPECT_EQ("exceeded parse limit.", err);
+}
+
+TEST(MSGPACK_LIMITS, max_bytes)
+{
+    std::string const dumped = msgpack11::MsgPack(msgpack11::MsgPack::array { "abc", 1 }).dump();
+    msgpack11::MsgPack::ParseOptions options;
+    std::string err;
+
+    // Trailing input past the document does not count.
+    options.max_bytes = dumped.size();
+    EXPECT_FALSE(parse_with(dumped + "trailing", options, err).is_null());
+    EXPECT_TRUE(err.empty());
+
+    options.max_bytes = dumped.size() - 1;
+    EXPECT_TRUE(parse_with(dumped, options, err).is_null());
+    EXPECT_EQ("exceeded parse limit.", err);
+
+    // A truncated document within the limit is still reported as such.
+    err.clear();
+    EXPECT_TRUE(parse_with(dumped.substr(0, dumped.size() - 1), msgpack11::MsgPack::ParseOptions(), err).is_null());
+    EXPECT_EQ("end of buffer.", err);
+}
+
+TEST(MSGPACK_LIMITS, declared_lengths_without_data)
+{
+    // Headers declaring 4 GiB - 1 of payload or elements, with nothing after.
+    std::string const inputs[] = {
+        std::string("\xdb\xff\xff\xff\xff", 5),
+        std::string("\xc6\xff\xff\xff\xff", 5),
+        std::string("\xdd\xff\xff\xff\xff", 5),
+        std::string("\xdf\xff\xff\xff\xff", 5),
+    };
+    for (const std::string& in : inputs) {
+        std::string err;
+        EXPECT_TRUE(msgpack11::MsgPack::parse(in, err).is_null());
+        EXPECT_EQ("end of buffer.", err);
+
+        std::istringstream stream(in);
+        msgpack11::MsgPack value;
+        stream >> value;
+        EXPECT_TRUE(stream.fail());
+        EXPECT_TRUE(value.is_null());
+
+        std::vector<msgpack11::MsgPack::key_path> const paths = { { "*" } };
+        EXPECT_TRUE(msgpack11::MsgPack::parse_projected(in.data(), in.size(), paths, err).is_null());
+        EXPECT_FALSE(err.empty());
+    }
+}
+
+TEST(MSGPACK_LIMITS, other_entry_points)
+{
+    msgpack11::MsgPack const packed = msgpack11::MsgPack::object {
+        { "small", "abc" },
+        { "large", std::string(1000, 'x') },
+        { "list", msgpack11::MsgPack::array { 1, 2, 3, 4, 5 } }
+    };
+    std::string const dumped = packed.dump();
+
+    msgpack11::MsgPack::ParseOptions options;
+    options.max_payload = 100;
+    std::string err;
+
+    std::istringstream stream(dumped);
+    EXPECT_TRUE(msgpack11::MsgPack::parse(stream, err, options).is_null());
+    EXPECT_EQ("exceeded parse limit.", err);
+
+    std::vector<msgpack11::MsgPack::key_path> paths = { { "large" } };
+    EXPECT_TRUE(msgpack11::MsgPack::parse_projected(dumped.data(), dumped.size(), paths, err, options).is_null());
+    EXPECT_EQ("exceeded parse limit.", err);
+    // Skipped subtrees are not limited.
+    paths = { { "small" } };
+    err.clear();
+    EXPECT_EQ(msgpack11::MsgPack(msgpack11::MsgPack::object { { "small", "abc" } }),
+              msgpack11::MsgPack::parse_projected(dumped.data(), dumped.size(), paths, err, options));
+    EXPECT_TRUE(err.empty());
+
+    msgpack11::MsgPackValidation result = msgpack11::validate(dumped.data(), dumped.size(), options);
+    EXPECT_EQ(msgpack11::MsgPackValidation::EXCEEDED, result.status);
+
+    options = msgpack11::MsgPack::ParseOptions();
+    options.max_elements = 4;
+    result = msgpack11::validate(dumped.data(), dumped.size(), options);
+    EXPECT_EQ(msgpack11::MsgPackValidation::EXCEEDED, result.status);
+    paths = { { "list", "*" } };
+    EXPECT_TRUE(msgpack11::MsgPack::parse_projected(dumped.data(), dumped.size(), paths, err, options).is_null());
+    EXPECT_EQ("exceeded parse limit.", err);
+
+    options = msgpack11::MsgPack::ParseOptions();
+    options.max_nodes = 11;
+    result = msgpack11::validate(dumped.data(), dumped.size(), options);
+    EXPECT_EQ(msgpack11::MsgPackValidation::EXCEEDED, result.status);
+    options.max_nodes = 12;
+    result = msgpack11::validate(dumped.data(), dumped.size(), options);
+    EXPECT_EQ(msgpack11::MsgPackValidation::VALID, result.status);
+    EXPECT_EQ(dumped.size(), result.size);
+
+    options = msgpack11::MsgPack::ParseOptions();
+    options.max_bytes = dumped.size() - 1;
+    result = msgpack11::validate(dumped.data(), dumped.size(), options);
+    EXPECT_EQ(msgpack11::MsgPackValidation::EXCEEDED, result.status);
+    std::istringstream short_stream(dumped);
+    EXPECT_TRUE(msgpack11::MsgPack::parse(short_stream, err, options).is_null());
+    EXPECT_EQ("exceeded parse limit.", err);
+    std::istringstream full_stream(dumped);
+    options.max_bytes = dumped.size();
+    err.clear();
+    EXPECT_EQ(packed, msgpack11::MsgPack::parse(full_stream, err, options));
+    EXPECT_TRUE(err.empty());
+}
+
+TEST(MSGPACK_LIMITS, incremental_checks_before_buffering)
+{
+    msgpack11::MsgPack::ParseOptions options;
+    options.max_payload = 1 << 20;
+
+    // A str32 declaring 4 GiB fails on its header alone.
+    msgpack11::MsgPackIncrementalParser parser(options);
+    EXPECT_FALSE(parser.feed("\xdb\xff\xff\xff\xff", 5));
+    EXPECT_TRUE(parser.exceeded());
+
+    // So does one whose header arrives a byte at a time.
+    parser.reset();
+    EXPECT_TRUE(parser.feed("\xc6\xff", 2));
+    EXPECT_FALSE(parser.feed("\xff\xff\xff" "abc", 6));
+    EXPECT_TRUE(parser.exceeded());
+
+    // A payload within the limit is put together from any chunks, and each
+    // top-level value gets the whole limit.
+    parser.reset();
+    std::string const dumped = msgpack11::MsgPack(std::string(1 << 20, 'x')).dump();
+    std::string const twice = dumped + dumped;
+    for (size_t i = 0; i < twice.size(); i += 1000) {
+        ASSERT_TRUE(parser.feed(twice.data() + i, std::min<size_t>(1000, twice.size() - i)));
+    }
+    msgpack11::MsgPack value;
+    ASSERT_TRUE(parser.next(value));
+    EXPECT_EQ(size_t(1) << 20, value.string_value().size());
+    ASSERT_TRUE(parser.next(value));
+    EXPECT_TRUE(parser.idle());
+
+    options = msgpack11::MsgPack::ParseOptions();
+    options.max_elements = 2;
+    msgpack11::MsgPackIncrementalParser elements(options);
+    EXPECT_TRUE(elements.feed("\x92\x01\x02", 3));
+    EXPECT_FALSE(elements.feed("\x93", 1));
+    EXPECT_TRUE(elements.exceeded());
+
+    options = msgpack11::MsgPack::ParseOptions();
+    options.max_nodes = 3;
+    options.max_bytes = 3;
+    msgpack11::MsgPackIncrementalParser nodes(options);
+    EXPECT_TRUE(nodes.feed("\x92\x01\x02\x92\x01\x91", 6));
+    EXPECT_FALSE(nodes.feed("\x01", 1));
+    EXPECT_TRUE(nodes.exceeded());
+    ASSERT_TRUE(nodes.next(value));
+    EXPECT_EQ(msgpack11::MsgPack(msgpack11::MsgPack::array { 1, 2 }), value);
+}
@@ -44,3 +44,34 @@ TEST(MSGPACK_MULTI, pack_unpack_multi)
     EXPECT_EQ(v3.size(), parsed_v3.size());
     EXPECT_TRUE(std::equal(v3.begin(), v3.end(), parsed_v3.begin()));
 }
+
+TEST(MSGPACK_MULTI, parse_multi_parallel)
+{
+    std::string buffer;
+    for (int i = 0; i < 5000; ++i) {
+        msgpack11::MsgPack::object v{
+            { "index", i },
+            { "name", std::string(static_cast<size_t>(i % 40), 'n') },
+            { "values", msgpack11::MsgPack::array { i * 0.5, -i, "v" } }
+        };
+        buffer += msgpack11::MsgPack(v).dump();
+    }
+    std::string const& complete = buffer;
+    std::string const truncated = buffer + msgpack11::MsgPack(std::string(10, 'x')).dump().substr(0, 5);
+
+    for (const std::string* in : { &complete, &truncated }) {
+        std::string serial_err;
+        std::string::size_type serial_stop_pos;
+        std::vector<msgpack11::MsgPack> serial = msgpack11::MsgPack::parse_multi(*in, serial_stop_pos, serial_err);
+
+        for (unsigned threads : { 0u, 1u, 4u }) {
+            std::string err;
+            std::string::size_type stop_pos;
+            std::vector<msgpack11::MsgPack> parallel = msgpack11::MsgPack::parse_multi(*in, stop_pos, err, threads);
+            EXPECT_EQ(serial_err, err);
+            EXPECT_EQ(serial_stop_pos, stop_pos);
+            ASSERT_EQ(5000u, parallel.size());
+            EXPECT_TRUE(serial == parallel);
+        }
+    }
+}
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <type_traits>
 
 #include <gtest/gtest.h>
 
@@ -39,3 +40,91 @@ TEST(MSGPACK_OBJECT, pack_unpack_object)
     msgpack11::MsgPack::object v2{ parsed.object_items() };
     EXPECT_TRUE(v1 == v2);
 }
+
+TEST(MSGPACK_OBJECT, sorted_unique_keys)
+{
+    msgpack11::MsgPack::object v1{
+        {"c", 3},
+        {"a", 1},
+        {"b", 2},
+        {"a", 100}
+    };
+    ASSERT_EQ(3u, v1.size());
+    EXPECT_EQ("a", v1.begin()->first.string_value());
+    EXPECT_EQ(1, v1.begin()->second.int_value());
+    EXPECT_EQ("c", (v1.end() - 1)->first.string_value());
+
+    EXPECT_FALSE(v1.insert(std::make_pair(msgpack11::MsgPack("b"), msgpack11::MsgPack(20))).second);
+    EXPECT_TRUE(v1.insert(std::make_pair(msgpack11::MsgPack("ab"), msgpack11::MsgPack(4))).second);
+    v1["d"] = 5;
+    EXPECT_EQ(5u, v1.size());
+    EXPECT_EQ(1u, v1.count("ab"));
+    EXPECT_EQ(1u, v1.erase("ab"));
+    EXPECT_TRUE(v1.find("ab") == v1.end());
+
+    // Duplicate keys on the wire keep the first value, as std::map::insert does.
+    const char dumped[] = { '\x82', '\xa1', 'k', '\x01', '\xa1', 'k', '\x02' };
+    std::string err;
+    msgpack11::MsgPack parsed = msgpack11::MsgPack::parse(dumped, sizeof(dumped), err);
+    EXPECT_TRUE(err.empty());
+    ASSERT_EQ(1u, parsed.object_items().size());
+    EXPECT_EQ(1, parsed["k"].int_value());
+}
+
+TEST(MSGPACK_OBJECT, string_key_lookup)
+{
+    msgpack11::MsgPack const packed = msgpack11::MsgPack::object {
+        {1, "int"},
+        {true, "bool"},
+        {"key", "string"},
+        {"keys", "longer string"},
+        {msgpack11::MsgPack::binary{'k', 'e', 'y'}, "binary"}
+    };
+    msgpack11::MsgPack::object const& items = packed.object_items();
+
+    EXPECT_EQ("string", packed["key"].string_value());
+    EXPECT_EQ("longer string", packed[std::string("keys")].string_value());
+    EXPECT_EQ("string", packed.get("keyboard", 3).string_value());
+    EXPECT_TRUE(packed["ke"].is_null());
+    EXPECT_TRUE(packed.get("keysz", 5).is_null());
+
+    char name[] = "keys";
+    EXPECT_TRUE(items.find(name) != items.end());
+    EXPECT_TRUE(items.find("binary") == items.end());
+    EXPECT_EQ("int", items.find(1)->second.string_value());
+
+    EXPECT_TRUE(msgpack11::MsgPack(1)["key"].is_null());
+}
+
+
+TEST(MSGPACK_OBJECT, stable_references)
+{
+    msgpack11::MsgPack::object items{ {"m", 1} };
+    msgpack11::MsgPack& m = items["m"];
+    const msgpack11::MsgPack::object::value_type* const pair = &*items.begin();
+    for (int i = 0; i < 1000; ++i) {
+        items[std::to_string(i)] = i;
+    }
+    EXPECT_EQ(1, m.int_value());
+    m = 2;
+    EXPECT_EQ(2, items["m"].int_value());
+    EXPECT_EQ(pair, &*items.find("m"));
+
+    EXPECT_EQ(1u, items.erase(msgpack11::MsgPack("500")));
+    items["x"] = 3;
+    EXPECT_EQ(2, m.int_value());
+    EXPECT_EQ(1001u, items.size());
+
+    for (auto& item : items) {
+        item.second = item.second.int_value() * 10;
+    }
+    std::pair<const msgpack11::MsgPack, msgpack11::MsgPack>& first = *items.begin();
+    EXPECT_EQ("0", first.first.string_value());
+    EXPECT_EQ(20, m.int_value());
+    EXPECT_EQ(30, items["x"].int_value());
+
+    msgpack11::MsgPack::object const copy(items);
+    EXPECT_TRUE(copy == items);
+    EXPECT_EQ(2u, copy.count(std::string("m")) + copy.count("x"));
+    EXPECT_EQ(0u, copy.count("500", 3));
+}
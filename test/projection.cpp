@@ -0,0 +1,87 @@
+#include <msgpack11.hpp>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+TEST(MSGPACK_PROJECTION, select_paths)
+{
+    msgpack11::MsgPack packed{ msgpack11::MsgPack::object {
+        { "header", msgpack11::MsgPack::object { { "id", 7 }, { "route", "a/b" } } },
+        { "items", msgpack11::MsgPack::array {
+            msgpack11::MsgPack::object { { "price", 1.5 }, { "name", "x" } },
+            msgpack11::MsgPack::object { { "name", "y" } },
+            3
+        } },
+        { "body", msgpack11::MsgPack::binary(1000, 0x11) },
+        { "meta", msgpack11::MsgPack::object { { "tags", msgpack11::MsgPack::array { 1, 2 } } } }
+    } };
+    std::string const dumped = packed.dump();
+
+    std::string err;
+    msgpack11::MsgPack projected = msgpack11::MsgPack::parse_projected(dumped.data(), dumped.size(),
+        { { "header", "id" }, { "items", "*", "price" }, { "meta" } }, err);
+    EXPECT_TRUE(err.empty());
+
+    msgpack11::MsgPack expected{ msgpack11::MsgPack::object {
+        { "header", msgpack11::MsgPack::object { { "id", 7 } } },
+        { "items", msgpack11::MsgPack::array {
+            msgpack11::MsgPack::object { { "price", 1.5 } },
+            msgpack11::MsgPack::object {},
+            nullptr
+        } },
+        { "meta", packed["meta"] }
+    } };
+    EXPECT_EQ(expected, projected);
+
+    projected = msgpack11::MsgPack::parse_projected(dumped.data(), dumped.size(), { { "missing" } }, err);
+    EXPECT_TRUE(err.empty());
+    EXPECT_EQ(msgpack11::MsgPack(msgpack11::MsgPack::object {}), projected);
+
+    projected = msgpack11::MsgPack::parse_projected(dumped.data(), dumped.size(), { {} }, err);
+    EXPECT_EQ(packed, projected);
+}
+
+TEST(MSGPACK_PROJECTION, malformed_skipped_value)
+{
+    std::string dumped = msgpack11::MsgPack(msgpack11::MsgPack::object {
+        { "a", 1 },
+        { "b", std::string(100, 'z') }
+    }).dump();
+
+    std::string err;
+    msgpack11::MsgPack projected = msgpack11::MsgPack::parse_projected(dumped.data(), dumped.size() - 1, { { "a" } }, err);
+    EXPECT_FALSE(err.empty());
+    EXPECT_TRUE(projected.is_null());
+}
+
+TEST(MSGPACK_PROJECTION, overlapping_paths)
+{
+    msgpack11::MsgPack const packed = msgpack11::MsgPack::object {
+        { "header", msgpack11::MsgPack::object { { "id", 1 }, { "ts", 2 }, { "x", 3 } } },
+        { "body", msgpack11::MsgPack::object { { "id", 4 }, { "ts", 5 } } },
+        { "list", msgpack11::MsgPack::array { msgpack11::MsgPack::object { { "id", 6 }, { "ts", 7 } } } }
+    };
+    std::string dumped = packed.dump();
+
+    std::string err;
+    msgpack11::MsgPack projected = msgpack11::MsgPack::parse_projected(dumped.data(), dumped.size(),
+        { { "*", "id" }, { "header", "ts" } }, err);
+    EXPECT_TRUE(err.empty());
+    msgpack11::MsgPack expected = msgpack11::MsgPack::object {
+        { "header", msgpack11::MsgPack::object { { "id", 1 }, { "ts", 2 } } },
+        { "body", msgpack11::MsgPack::object { { "id", 4 } } }
+    };
+    EXPECT_EQ(expected, projected);
+
+    // Overlaps below the first step merge too, and a whole value wins.
+    projected = msgpack11::MsgPack::parse_projected(dumped.data(), dumped.size(),
+        { { "*", "*", "ts" }, { "list", "*", "id" }, { "header" } }, err);
+    EXPECT_TRUE(err.empty());
+    expected = msgpack11::MsgPack::object {
+        { "header", packed["header"] },
+        { "body", msgpack11::MsgPack::object {} },
+        { "list", msgpack11::MsgPack::array { msgpack11::MsgPack::object { { "id", 6 }, { "ts", 7 } } } }
+    };
+    EXPECT_EQ(expected, projected);
+}
@@ -0,0 +1,80 @@
+#include <msgpack11.hpp>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+TEST(MSGPACK_READER, read_tokens)
+{
+    msgpack11::MsgPack packed{ msgpack11::MsgPack::object {
+        { "id", 42 },
+        { "name", "abc" },
+        { "tags", msgpack11::MsgPack::array { -1, 2.5 } }
+    } };
+    std::string dumped = packed.dump();
+
+    msgpack11::MsgPackReader reader(dumped.data(), dumped.size());
+    msgpack11::MsgPackToken token;
+
+    ASSERT_TRUE(reader.next(token));
+    EXPECT_EQ(msgpack11::MsgPack::OBJECT, token.type);
+    EXPECT_EQ(3u, token.length);
+
+    ASSERT_TRUE(reader.next(token));
+    EXPECT_EQ(msgpack11::MsgPack::STRING, token.type);
+    EXPECT_EQ("id", std::string(token.string_data(), token.length));
+    ASSERT_TRUE(reader.next(token));
+    EXPECT_EQ(msgpack11::MsgPack::UINT8, token.type);
+    EXPECT_EQ(42u, token.uint_value);
+
+    ASSERT_TRUE(reader.next(token));
+    EXPECT_EQ("name", std::string(token.string_data(), token.length));
+    ASSERT_TRUE(reader.next(token));
+    EXPECT_EQ(msgpack11::MsgPack::STRING, token.type);
+    EXPECT_EQ("abc", std::string(token.string_data(), token.length));
+
+    ASSERT_TRUE(reader.next(token));
+    EXPECT_EQ("tags", std::string(token.string_data(), token.length));
+    ASSERT_TRUE(reader.next(token));
+    EXPECT_EQ(msgpack11::MsgPack::ARRAY, token.type);
+    EXPECT_EQ(2u, token.length);
+    ASSERT_TRUE(reader.next(token));
+    EXPECT_EQ(msgpack11::MsgPack::INT8, token.type);
+    EXPECT_EQ(-1, token.int_value);
+    ASSERT_TRUE(reader.next(token));
+    EXPECT_EQ(msgpack11::MsgPack::FLOAT64, token.type);
+    EXPECT_EQ(2.5, token.float64_value);
+
+    EXPECT_TRUE(reader.at_end());
+    EXPECT_FALSE(reader.next(token));
+    EXPECT_STREQ("end of buffer.", reader.error());
+}
+
+TEST(MSGPACK_READER, skip_values)
+{
+    msgpack11::MsgPack first{ msgpack11::MsgPack::array {
+        msgpack11::MsgPack::object { { "a", msgpack11::MsgPack::array { 1, 2, 3 } } },
+        msgpack11::MsgPack::binary { 1, 2, 3 },
+        "xyz"
+    } };
+    std::string dumped = first.dump() + msgpack11::MsgPack{7}.dump();
+
+    msgpack11::MsgPackReader reader(dumped.data(), dumped.size());
+    EXPECT_TRUE(reader.skip());
+    EXPECT_EQ(first.encoded_size(), dumped.size() - reader.remaining());
+
+    msgpack11::MsgPackToken token;
+    ASSERT_TRUE(reader.next(token));
+    EXPECT_EQ(7u, token.uint_value);
+    EXPECT_TRUE(reader.at_end());
+    EXPECT_EQ(nullptr, reader.error());
+}
+
+TEST(MSGPACK_READER, skip_incomplete)
+{
+    std::string dumped = msgpack11::MsgPack{ msgpack11::MsgPack::array { 1, "abc" } }.dump();
+
+    msgpack11::MsgPackReader reader(dumped.data(), dumped.size() - 1);
+    EXPECT_FALSE(reader.skip());
+    EXPECT_STREQ("end of buffer.", reader.error());
+}
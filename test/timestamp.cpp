@@ -0,0 +1,114 @@
+#include <msgpack11.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+struct Event {
+    std::string name;
+    msgpack11::MsgPack::timestamp at;
+    MSGPACK11_FIELDS(name, at)
+};
+}
+
+TEST(MSGPACK_TIMESTAMP, smallest_form)
+{
+    struct {
+        msgpack11::MsgPack::timestamp value;
+        std::string encoded;
+    } const cases[] = {
+        { { 0, 0 }, std::string("\xd6\xff\x00\x00\x00\x00", 6) },
+        { { 0xffffffff, 0 }, std::string("\xd6\xff\xff\xff\xff\xff", 6) },
+        { { 0x100000000, 0 }, std::string("\xd7\xff\x00\x00\x00\x01\x00\x00\x00\x00", 10) },
+        { { 1, 1 }, std::string("\xd7\xff\x00\x00\x00\x04\x00\x00\x00\x01", 10) },
+        { { 0x3ffffffff, 999999999 }, std::string("\xd7\xff\xee\x6b\x27\xff\xff\xff\xff\xff", 10) },
+        { { 0x400000000, 0 }, std::string("\xc7\x0c\xff\x00\x00\x00\x00\x00\x00\x00\x04\x00\x00\x00\x00", 15) },
+        { { -1, 500 }, std::string("\xc7\x0c\xff\x00\x00\x01\xf4\xff\xff\xff\xff\xff\xff\xff\xff", 15) },
+    };
+    for (const auto& c : cases) {
+        msgpack11::MsgPack const value(c.value);
+        EXPECT_TRUE(value.is_extension());
+        EXPECT_TRUE(value.is_timestamp());
+        ASSERT_NE(nullptr, value.extension_value<msgpack11::MsgPack::timestamp>());
+        EXPECT_TRUE(c.value == *value.extension_value<msgpack11::MsgPack::timestamp>());
+        EXPECT_EQ(c.encoded, value.dump());
+
+        std::string written;
+        msgpack11::MsgPackWriter writer(written);
+        writer.write(c.value);
+        EXPECT_EQ(c.encoded, written);
+
+        std::string err;
+        msgpack11::MsgPack const parsed = msgpack11::MsgPack::parse(c.encoded, err);
+        EXPECT_TRUE(err.empty());
+        EXPECT_EQ(value, parsed);
+        EXPECT_TRUE(c.value == parsed.timestamp_value());
+    }
+}
+
+TEST(MSGPACK_TIMESTAMP, invalid_payloads)
+{
+    msgpack11::MsgPack::timestamp value = { 7, 7 };
+    uint8_t const five[5] = { 0, 0, 0, 0, 1 };
+    EXPECT_FALSE(msgpack11::MsgPack::timestamp::decode(five, sizeof(five), value));
+    // 1000000000 nanoseconds in the 96 bit form.
+    uint8_t const overflow[12] = { 0x3b, 0x9a, 0xca, 0x00, 0, 0, 0, 0, 0, 0, 0, 1 };
+    EXPECT_FALSE(msgpack11::MsgPack::timestamp::decode(overflow, sizeof(overflow), value));
+    EXPECT_TRUE(value == (msgpack11::MsgPack::timestamp { 7, 7 }));
+
+    msgpack11::MsgPack const other_type(msgpack11::MsgPack::extension(1, msgpack11::MsgPack::binary(4, 0)));
+    EXPECT_FALSE(other_type.is_timestamp());
+    EXPECT_TRUE(other_type.timestamp_value() == (msgpack11::MsgPack::timestamp { 0, 0 }));
+    EXPECT_FALSE(msgpack11::MsgPack(int32_t(5)).is_timestamp());
+}
+
+TEST(MSGPACK_TIMESTAMP, normalizes_nanoseconds)
+{
+    struct {
+        msgpack11::MsgPack::timestamp value;
+        msgpack11::MsgPack::timestamp normalized;
+    } const cases[] = {
+        // Fits the 30 bit field but is not a valid nanosecond count.
+        { { 5, 1000000000 }, { 6, 0 } },
+        { { 5, 1073741823 }, { 6, 73741823 } },
+        // Would not fit the 30 bit field at all.
+        { { 5, 0xffffffff }, { 9, 294967295 } },
+        { { -1, 2000000001 }, { 1, 1 } },
+    };
+    for (const auto& c : cases) {
+        uint8_t payload[12];
+        size_t const len = c.value.encode(payload);
+        msgpack11::MsgPack::timestamp decoded = { 0, 0 };
+        EXPECT_TRUE(msgpack11::MsgPack::timestamp::decode(payload, len, decoded));
+        EXPECT_TRUE(c.normalized == decoded);
+
+        std::string err;
+        msgpack11::MsgPack const parsed = msgpack11::MsgPack::parse(msgpack11::MsgPack(c.value).dump(), err);
+        EXPECT_TRUE(err.empty());
+        EXPECT_TRUE(c.normalized == parsed.timestamp_value());
+    }
+}
+
+TEST(MSGPACK_TIMESTAMP, codec)
+{
+    std::vector<Event> const events = { { "start", { 1700000000, 0 } }, { "stop", { 1700000001, 250000000 } } };
+    std::string const encoded = msgpack11::encode(events);
+
+    std::vector<Event> decoded;
+    std::string err;
+    EXPECT_TRUE(msgpack11::decode(encoded, decoded, err));
+    ASSERT_EQ(2u, decoded.size());
+    EXPECT_EQ("stop", decoded[1].name);
+    EXPECT_TRUE(events[1].at == decoded[1].at);
+    EXPECT_TRUE(events[0].at < decoded[1].at);
+
+    msgpack11::MsgPack const parsed = msgpack11::MsgPack::parse(encoded, err);
+    EXPECT_TRUE(events[0].at == parsed[0][1].timestamp_value());
+
+    msgpack11::MsgPack::timestamp at;
+    EXPECT_FALSE(msgpack11::decode(msgpack11::encode(int32_t(1)), at, err));
+    EXPECT_EQ("type mismatch.", err);
+}
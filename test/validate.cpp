@@ -0,0 +1,81 @@
+#include <msgpack11.hpp>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(MSGPACK_VALIDATE, framing)
+{
+    std::vector<int8_t> small(100);
+    for (size_t i = 0; i < small.size(); ++i) {
+        small[i] = static_cast<int8_t>(i % 2 ? -static_cast<int>(i % 32) : static_cast<int>(i));
+    }
+    msgpack11::MsgPack packed{ msgpack11::MsgPack::object {
+        { "ints", small },
+        { "nested", msgpack11::MsgPack::array { msgpack11::MsgPack::array { 1000, "x" } } },
+        { "empty", msgpack11::MsgPack::array {} }
+    } };
+    std::string const dumped = packed.dump();
+    std::string const framed = dumped + dumped;
+
+    msgpack11::MsgPackValidation result = msgpack11::validate(framed.data(), framed.size());
+    EXPECT_EQ(msgpack11::MsgPackValidation::VALID, result.status);
+    EXPECT_EQ(dumped.size(), result.size);
+    EXPECT_EQ(1u + 3u + 101u + 4u + 1u, result.nodes);
+    EXPECT_EQ(4u, result.max_depth);
+
+    result = msgpack11::validate(dumped.data(), dumped.size() - 1);
+    EXPECT_EQ(msgpack11::MsgPackValidation::INCOMPLETE, result.status);
+
+    result = msgpack11::validate("\x01", 1);
+    EXPECT_EQ(msgpack11::MsgPackValidation::VALID, result.status);
+    EXPECT_EQ(1u, result.size);
+    EXPECT_EQ(1u, result.max_depth);
+
+    result = msgpack11::validate("\x92\x01\xc1", 3);
+    EXPECT_EQ(msgpack11::MsgPackValidation::MALFORMED, result.status);
+    EXPECT_EQ(2u, result.size);
+}
+
+TEST(MSGPACK_VALIDATE, depth_limit_matches_parse)
+{
+    for (size_t depth : { 200u, 201u, 202u }) {
+        std::string nested(depth, '\x91');
+        nested.push_back('\x01');
+
+        std::string err;
+        msgpack11::MsgPack::parse(nested, err);
+        msgpack11::MsgPackValidation result = msgpack11::validate(nested.data(), nested.size());
+        EXPECT_EQ(err.empty(), result.status == msgpack11::MsgPackValidation::VALID) << depth;
+    }
+}
+
+TEST(MSGPACK_VALIDATE, depth_limit_from_options)
+{
+    std::string nested(1000, '\x91');
+    nested.push_back('\x01');
+    std::string const framed = nested + nested;
+
+    msgpack11::MsgPack::ParseOptions options;
+    options.max_depth = 1000;
+    msgpack11::MsgPackValidation result = msgpack11::validate(nested.data(), nested.size(), options);
+    EXPECT_EQ(msgpack11::MsgPackValidation::VALID, result.status);
+    EXPECT_EQ(1001u, result.max_depth);
+
+    std::string err;
+    size_t stop = 0;
+    std::vector<msgpack11::MsgPack> values =
+        msgpack11::MsgPack::parse_multi(framed.data(), framed.size(), stop, err, 2, options);
+    EXPECT_TRUE(err.empty());
+    EXPECT_EQ(framed.size(), stop);
+    ASSERT_EQ(2u, values.size());
+    EXPECT_EQ(msgpack11::MsgPack::parse(nested.data(), nested.size(), err, options), values[1]);
+
+    options.max_depth = 999;
+    result = msgpack11::validate(nested.data(), nested.size(), options);
+    EXPECT_EQ(msgpack11::MsgPackValidation::MALFORMED, result.status);
+    values = msgpack11::MsgPack::parse_multi(framed.data(), framed.size(), stop, err, 2, options);
+    EXPECT_EQ("format error.", err);
+    EXPECT_TRUE(values.empty());
+}
@@ -0,0 +1,122 @@
+#include <msgpack11.hpp>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+class RecordingVisitor : public msgpack11::MsgPackVisitor {
+public:
+    bool on_nil() override { events.push_back("nil"); return true; }
+    bool on_bool(bool v) override { events.push_back(v ? "true" : "false"); return true; }
+    bool on_int(int64_t v) override { events.push_back("int:" + std::to_string(v)); return true; }
+    bool on_uint(uint64_t v) override { events.push_back("uint:" + std::to_string(v)); return true; }
+    bool on_float64(double v) override { events.push_back("float64:" + std::to_string(v)); return true; }
+    bool on_string(const char* p, size_t n) override { events.push_back("str:" + std::string(p, n)); return true; }
+    bool on_binary(const uint8_t*, size_t n) override { events.push_back("bin:" + std::to_string(n)); return true; }
+    bool on_extension(int8_t t, const uint8_t*, size_t n) override {
+        events.push_back("ext:" + std::to_string(t) + ":" + std::to_string(n));
+        return true;
+    }
+    bool on_array_begin(uint32_t n) override { events.push_back("[" + std::to_string(n)); return true; }
+    bool on_array_end() override { events.push_back("]"); return true; }
+    bool on_map_begin(uint32_t n) override { events.push_back("{" + std::to_string(n)); return true; }
+    bool on_map_end() override { events.push_back("}"); return true; }
+
+    std::vector<std::string> events;
+};
+
+class StopAtString : public msgpack11::MsgPackVisitor {
+public:
+    bool on_uint(uint64_t) override { ++count; return true; }
+    bool on_string(const char*, size_t) override { return false; }
+
+    int count = 0;
+};
+} // namespace
+
+TEST(MSGPACK_VISITOR, visit_events)
+{
+    msgpack11::MsgPack packed{ msgpack11::MsgPack::array {
+        nullptr, true, -5, 300, 1.5, "abc",
+        msgpack11::MsgPack::binary { 1, 2 },
+        msgpack11::MsgPack::extension { 7, msgpack11::MsgPack::binary { 1, 2, 3, 4 } },
+        msgpack11::MsgPack::object { { "k", msgpack11::MsgPack::array {} } }
+    } };
+    std::string dumped = packed.dump();
+
+    RecordingVisitor visitor;
+    std::string err;
+    EXPECT_TRUE(msgpack11::MsgPack::parse(dumped.data(), dumped.size(), visitor, err));
+    EXPECT_TRUE(err.empty());
+
+    std::vector<std::string> expected {
+        "[9", "nil", "true", "int:-5", "uint:300", "float64:" + std::to_string(1.5), "str:abc",
+        "bin:2", "ext:7:4", "{1", "str:k", "[0", "]", "}", "]"
+    };
+    EXPECT_EQ(expected, visitor.events);
+}
+
+TEST(MSGPACK_VISITOR, visit_stop)
+{
+    msgpack11::MsgPack packed{ msgpack11::MsgPack::array { 1, 2, "stop", 3 } };
+    std::string dumped = packed.dump();
+
+    StopAtString visitor;
+    std::string err;
+    EXPECT_FALSE(msgpack11::MsgPack::parse(dumped.data(), dumped.size(), visitor, err));
+    EXPECT_EQ(2, visitor.count);
+    EXPECT_EQ("stopped by visitor.", err);
+}
+
+TEST(MSGPACK_VISITOR, visit_incomplete)
+{
+    msgpack11::MsgPack packed{ msgpack11::MsgPack::array { 1, 2, "abc" } };
+    std::string dumped = packed.dump();
+
+    RecordingVisitor visitor;
+    std::string err;
+    EXPECT_FALSE(msgpack11::MsgPack::parse(dumped.data(), dumped.size() - 1, visitor, err));
+    EXPECT_EQ("end of buffer.", err);
+}
+
+TEST(MSGPACK_VISITOR, visit_nested)
+{
+    // Maps nested in arrays, each closing with the last of its parents.
+    std::string nested;
+    for (int i = 0; i < 100; ++i) {
+        nested += "\x91\x81\xa1k";
+    }
+    nested.push_back('\x01');
+
+    RecordingVisitor visitor;
+    std::string err;
+    EXPECT_TRUE(msgpack11::MsgPack::parse(nested.data(), nested.size(), visitor, err));
+    ASSERT_EQ(501u, visitor.events.size());
+    EXPECT_EQ("uint:1", visitor.events[300]);
+    EXPECT_EQ("}", visitor.events[301]);
+    EXPECT_EQ("]", visitor.events[500]);
+
+    nested.insert(0, "\x91");
+    EXPECT_FALSE(msgpack11::MsgPack::parse(nested.data(), nested.size(), visitor, err));
+    EXPECT_EQ("format error.", err);
+}
+
+TEST(MSGPACK_VISITOR, visit_depth_limit)
+{
+    std::string nested(1000, '\x91');
+    nested.push_back('\x01');
+
+    RecordingVisitor visitor;
+    std::string err;
+    msgpack11::MsgPack::ParseOptions options;
+    options.max_depth = 1000;
+    EXPECT_TRUE(msgpack11::MsgPack::parse(nested.data(), nested.size(), visitor, err, options));
+    ASSERT_EQ(2001u, visitor.events.size());
+    EXPECT_EQ("uint:1", visitor.events[1000]);
+
+    options.max_depth = 999;
+    EXPECT_FALSE(msgpack11::MsgPack::parse(nested.data(), nested.size(), visitor, err, options));
+    EXPECT_EQ("format error.", err);
+}
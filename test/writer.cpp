@@ -0,0 +1,65 @@
+#include <msgpack11.hpp>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+TEST(MSGPACK_WRITER, matches_dump)
+{
+    msgpack11::MsgPack const expected = msgpack11::MsgPack::array {
+        nullptr, true, 1.5f, 2.25,
+        static_cast<int64_t>(-5), static_cast<int64_t>(-40000), static_cast<int64_t>(-5000000000LL),
+        static_cast<uint64_t>(200), static_cast<uint64_t>(70000), static_cast<uint64_t>(5000000000ULL),
+        "short", std::string(300, 's'),
+        msgpack11::MsgPack::binary(3, 0x11),
+        msgpack11::MsgPack::extension{ 5, msgpack11::MsgPack::binary(4, 0x22) },
+        msgpack11::MsgPack::extension{ -2, msgpack11::MsgPack::binary(20, 0x33) },
+        msgpack11::MsgPack::object { { "k", msgpack11::MsgPack::array { 1, 2 } } }
+    };
+
+    std::string out;
+    msgpack11::MsgPackWriter writer(out);
+    writer.begin_array(16);
+    writer.write_nil();
+    writer.write(true);
+    writer.write(1.5f);
+    writer.write(2.25);
+    writer.write(static_cast<int64_t>(-5));
+    writer.write(static_cast<int64_t>(-40000));
+    writer.write(static_cast<int64_t>(-5000000000LL));
+    writer.write(static_cast<uint64_t>(200));
+    writer.write(static_cast<uint64_t>(70000));
+    writer.write(static_cast<uint64_t>(5000000000ULL));
+    writer.write_str("short", 5);
+    writer.write_str(std::string(300, 's'));
+    msgpack11::MsgPack::binary const bin(3, 0x11);
+    writer.write_bin(bin.data(), bin.size());
+    msgpack11::MsgPack::binary const ext4(4, 0x22);
+    writer.write_ext(5, ext4.data(), ext4.size());
+    msgpack11::MsgPack::binary const ext20(20, 0x33);
+    writer.write_ext(-2, ext20.data(), ext20.size());
+    writer.begin_map(1);
+    writer.write_str("k", 1);
+    writer.write(msgpack11::MsgPack(msgpack11::MsgPack::array { 1, 2 }));
+
+    EXPECT_EQ(expected.dump(), out);
+    EXPECT_EQ(out.size(), writer.size());
+
+    std::string err;
+    EXPECT_EQ(expected, msgpack11::MsgPack::parse(out, err));
+    EXPECT_TRUE(err.empty());
+}
+
+TEST(MSGPACK_WRITER, keeps_key_order)
+{
+    msgpack11::MsgPack::binary out;
+    msgpack11::MsgPackWriter writer(out);
+    writer.begin_map(2);
+    writer.write_str("b", 1);
+    writer.write(static_cast<uint8_t>(1));
+    writer.write_str("a", 1);
+    writer.write(static_cast<uint8_t>(2));
+
+    msgpack11::MsgPack::binary const expected { 0x82, 0xa1, 'b', 0x01, 0xa1, 'a', 0x02 };
+    EXPECT_EQ(expected, out);
+}